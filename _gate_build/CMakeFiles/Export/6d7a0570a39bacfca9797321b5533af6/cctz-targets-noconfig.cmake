@@ -0,0 +1,28 @@
+#----------------------------------------------------------------
+# Generated CMake target import file.
+#----------------------------------------------------------------
+
+# Commands may need to know the format version.
+set(CMAKE_IMPORT_FILE_VERSION 1)
+
+# Import target "cctz::cctz" for configuration ""
+set_property(TARGET cctz::cctz APPEND PROPERTY IMPORTED_CONFIGURATIONS NOCONFIG)
+set_target_properties(cctz::cctz PROPERTIES
+  IMPORTED_LINK_INTERFACE_LANGUAGES_NOCONFIG "CXX"
+  IMPORTED_LOCATION_NOCONFIG "${_IMPORT_PREFIX}/lib/libcctz.a"
+  )
+
+list(APPEND _cmake_import_check_targets cctz::cctz )
+list(APPEND _cmake_import_check_files_for_cctz::cctz "${_IMPORT_PREFIX}/lib/libcctz.a" )
+
+# Import target "cctz::time_tool" for configuration ""
+set_property(TARGET cctz::time_tool APPEND PROPERTY IMPORTED_CONFIGURATIONS NOCONFIG)
+set_target_properties(cctz::time_tool PROPERTIES
+  IMPORTED_LOCATION_NOCONFIG "${_IMPORT_PREFIX}/bin/time_tool"
+  )
+
+list(APPEND _cmake_import_check_targets cctz::time_tool )
+list(APPEND _cmake_import_check_files_for_cctz::time_tool "${_IMPORT_PREFIX}/bin/time_tool" )
+
+# Commands beyond this point should not need to know the version.
+set(CMAKE_IMPORT_FILE_VERSION)
@@ -0,0 +1,28 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/src/civil_time_detail.cc" "CMakeFiles/cctz.dir/src/civil_time_detail.cc.o" "gcc" "CMakeFiles/cctz.dir/src/civil_time_detail.cc.o.d"
+  "/root/repo/src/time_zone_fixed.cc" "CMakeFiles/cctz.dir/src/time_zone_fixed.cc.o" "gcc" "CMakeFiles/cctz.dir/src/time_zone_fixed.cc.o.d"
+  "/root/repo/src/time_zone_format.cc" "CMakeFiles/cctz.dir/src/time_zone_format.cc.o" "gcc" "CMakeFiles/cctz.dir/src/time_zone_format.cc.o.d"
+  "/root/repo/src/time_zone_if.cc" "CMakeFiles/cctz.dir/src/time_zone_if.cc.o" "gcc" "CMakeFiles/cctz.dir/src/time_zone_if.cc.o.d"
+  "/root/repo/src/time_zone_impl.cc" "CMakeFiles/cctz.dir/src/time_zone_impl.cc.o" "gcc" "CMakeFiles/cctz.dir/src/time_zone_impl.cc.o.d"
+  "/root/repo/src/time_zone_info.cc" "CMakeFiles/cctz.dir/src/time_zone_info.cc.o" "gcc" "CMakeFiles/cctz.dir/src/time_zone_info.cc.o.d"
+  "/root/repo/src/time_zone_libc.cc" "CMakeFiles/cctz.dir/src/time_zone_libc.cc.o" "gcc" "CMakeFiles/cctz.dir/src/time_zone_libc.cc.o.d"
+  "/root/repo/src/time_zone_lookup.cc" "CMakeFiles/cctz.dir/src/time_zone_lookup.cc.o" "gcc" "CMakeFiles/cctz.dir/src/time_zone_lookup.cc.o.d"
+  "/root/repo/src/time_zone_posix.cc" "CMakeFiles/cctz.dir/src/time_zone_posix.cc.o" "gcc" "CMakeFiles/cctz.dir/src/time_zone_posix.cc.o.d"
+  "/root/repo/src/zone_info_source.cc" "CMakeFiles/cctz.dir/src/zone_info_source.cc.o" "gcc" "CMakeFiles/cctz.dir/src/zone_info_source.cc.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
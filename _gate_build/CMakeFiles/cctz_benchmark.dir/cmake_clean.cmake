@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/cctz_benchmark.dir/src/cctz_benchmark.cc.o"
+  "CMakeFiles/cctz_benchmark.dir/src/cctz_benchmark.cc.o.d"
+  "cctz_benchmark"
+  "cctz_benchmark.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/cctz_benchmark.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
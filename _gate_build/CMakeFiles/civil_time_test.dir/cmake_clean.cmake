@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/civil_time_test.dir/src/civil_time_test.cc.o"
+  "CMakeFiles/civil_time_test.dir/src/civil_time_test.cc.o.d"
+  "civil_time_test"
+  "civil_time_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/civil_time_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
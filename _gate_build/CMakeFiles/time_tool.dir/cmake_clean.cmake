@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/time_tool.dir/src/time_tool.cc.o"
+  "CMakeFiles/time_tool.dir/src/time_tool.cc.o.d"
+  "time_tool"
+  "time_tool.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/time_tool.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/time_zone_format_test.dir/src/time_zone_format_test.cc.o"
+  "CMakeFiles/time_zone_format_test.dir/src/time_zone_format_test.cc.o.d"
+  "time_zone_format_test"
+  "time_zone_format_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/time_zone_format_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
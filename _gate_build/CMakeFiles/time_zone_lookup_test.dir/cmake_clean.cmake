@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/time_zone_lookup_test.dir/src/time_zone_lookup_test.cc.o"
+  "CMakeFiles/time_zone_lookup_test.dir/src/time_zone_lookup_test.cc.o.d"
+  "time_zone_lookup_test"
+  "time_zone_lookup_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/time_zone_lookup_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
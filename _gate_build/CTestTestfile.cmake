@@ -0,0 +1,13 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo
+# Build directory: /root/repo/_gate_build
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+add_test(civil_time_test "civil_time_test")
+set_tests_properties(civil_time_test PROPERTIES  ENVIRONMENT "TZDIR=/root/repo/testdata/zoneinfo" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;151;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(time_zone_lookup_test "time_zone_lookup_test")
+set_tests_properties(time_zone_lookup_test PROPERTIES  ENVIRONMENT "TZDIR=/root/repo/testdata/zoneinfo" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;161;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(time_zone_format_test "time_zone_format_test")
+set_tests_properties(time_zone_format_test PROPERTIES  ENVIRONMENT "TZDIR=/root/repo/testdata/zoneinfo" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;170;add_test;/root/repo/CMakeLists.txt;0;")
+subdirs("examples")
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/classic.dir/classic.cc.o"
+  "CMakeFiles/classic.dir/classic.cc.o.d"
+  "classic"
+  "classic.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/classic.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/epoch_shift.dir/epoch_shift.cc.o"
+  "CMakeFiles/epoch_shift.dir/epoch_shift.cc.o.d"
+  "epoch_shift"
+  "epoch_shift.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/epoch_shift.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/example1.dir/example1.cc.o"
+  "CMakeFiles/example1.dir/example1.cc.o.d"
+  "example1"
+  "example1.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/example1.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
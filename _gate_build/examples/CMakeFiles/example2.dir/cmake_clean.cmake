@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/example2.dir/example2.cc.o"
+  "CMakeFiles/example2.dir/example2.cc.o.d"
+  "example2"
+  "example2.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/example2.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/example3.dir/example3.cc.o"
+  "CMakeFiles/example3.dir/example3.cc.o.d"
+  "example3"
+  "example3.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/example3.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
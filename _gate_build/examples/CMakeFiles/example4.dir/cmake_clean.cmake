@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/example4.dir/example4.cc.o"
+  "CMakeFiles/example4.dir/example4.cc.o.d"
+  "example4"
+  "example4.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/example4.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -282,6 +282,14 @@ using detail::weekday;
 //   civil_day a(2015, 8, 13);
 //   weekday wd = get_weekday(a);  // wd == weekday::thursday
 //
+// A batch overload computes the weekday of each of n civil days,
+// writing wds[i] for days[i]. Its inner loop is branch-free so that
+// optimizing compilers can auto-vectorize it, which makes it the form
+// to prefer on columnar date workloads.
+//
+//   std::vector<weekday> wds(days.size());
+//   get_weekday(days.data(), days.size(), wds.data());
+//
 using detail::get_weekday;
 
 // Returns the civil_day that strictly follows or precedes the given
@@ -318,8 +326,38 @@ using detail::prev_weekday;
 //   civil_day b(2015, 12, 31);
 //   int yd_dec_31 = get_yearday(b);  // yd_dec_31 = 365
 //
+// As with get_weekday(), a branch-free batch overload computes the
+// day-of-year of each of n civil days, writing ydays[i] for days[i].
+//
+//   std::vector<int> ydays(days.size());
+//   get_yearday(days.data(), days.size(), ydays.data());
+//
 using detail::get_yearday;
 
+// A user-defined literal for civil_second, parsed entirely at compile
+// time so that hard-coded boundary timestamps cost nothing at startup
+// and malformed ones fail the build. The literal is "YYYY-MM-DD
+// HH:MM:SS" (a 'T' may separate the date and time), where the year may
+// carry a '-' sign, and trailing fields may be omitted at a field
+// boundary. Fields must be in their civil ranges — unlike the
+// civil_second constructor, nothing is normalized.
+//
+// Requires C++14 constexpr support; not available otherwise.
+//
+// Example:
+//   using namespace cctz::literals;
+//   constexpr cctz::civil_second kLaunch = "2026-08-26T00:00:00"_civil;
+//   constexpr cctz::civil_second kEpoch = "1970-01-01"_civil;
+#if __cpp_constexpr >= 201304 || (defined(_MSC_VER) && _MSC_VER >= 1910)
+namespace literals {
+
+constexpr civil_second operator"" _civil(const char* s, std::size_t len) {
+  return detail::parse_civil_literal(s, len);
+}
+
+}  // namespace literals
+#endif
+
 }  // namespace cctz
 
 #endif  // CCTZ_CIVIL_TIME_H_
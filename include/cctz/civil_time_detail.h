@@ -15,6 +15,7 @@
 #ifndef CCTZ_CIVIL_TIME_DETAIL_H_
 #define CCTZ_CIVIL_TIME_DETAIL_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <limits>
 #include <ostream>
@@ -566,6 +567,126 @@ CONSTEXPR_F int get_yearday(const civil_second& cs) noexcept {
 
 ////////////////////////////////////////////////////////////////////////
 
+// Batch counterparts of get_weekday() and get_yearday() for columnar
+// workloads: each writes out[i] for days[i], for i in [0, n). The loop
+// bodies are straight-line arithmetic on the already-normalized fields
+// (the only conditionals are value selections that compilers lower to
+// branch-free code), so the loops auto-vectorize well.
+
+inline void get_weekday(const civil_day* days, std::size_t n,
+                        weekday* wds) noexcept {
+  for (std::size_t i = 0; i != n; ++i) {
+    // A 400-year calendar cycle spans 146097 days, a multiple of 7, so
+    // reducing the year mod 400 preserves the weekday while keeping
+    // ymd_ord() far from overflow. Day ordinal 0 (1970-01-01) was a
+    // Thursday, whose enumerator value is 3.
+    const diff_t ord =
+        impl::ymd_ord(days[i].year() % 400, days[i].month(), days[i].day());
+    wds[i] = static_cast<weekday>((ord % 7 + 10) % 7);
+  }
+}
+
+inline void get_yearday(const civil_day* days, std::size_t n,
+                        int* ydays) noexcept {
+  for (std::size_t i = 0; i != n; ++i) {
+    const int m = days[i].month();
+    // The day of a March-based year, as in ymd_ord(), rebased to the
+    // January of the same calendar year.
+    const diff_t doy = (153 * (m + ((m > 2) ? -3 : 9)) + 2) / 5 +
+                       days[i].day() - 1;
+    ydays[i] = static_cast<int>(
+        doy + ((m > 2) ? 60 + impl::is_leap_year(days[i].year()) : -305));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////
+
+#if __cpp_constexpr >= 201304 || (defined(_MSC_VER) && _MSC_VER >= 1910)
+
+namespace impl {
+
+// Not defined. A call can only be reached from a malformed _civil
+// literal: in a constant expression it renders the program ill-formed
+// (the diagnostic names this function), and in any runtime evaluation
+// it fails to link. Either way the bad literal is a build error.
+civil_second bad_civil_literal(const char* reason);
+
+// Parses exactly n digits from s into *vp, returning true on success.
+CONSTEXPR_F bool parse_digits(const char* s, int n, int* vp) noexcept {
+  int v = 0;
+  while (n-- > 0) {
+    if (*s < '0' || *s > '9') return false;
+    v = v * 10 + (*s++ - '0');
+  }
+  *vp = v;
+  return true;
+}
+
+}  // namespace impl
+
+// Compile-time parsing for the "..."_civil literal (see civil_time.h).
+// The accepted form is "YYYY-MM-DD HH:MM:SS", where a 'T' may separate
+// the date and time, the year may carry a '-' sign and any number of
+// digits, and trailing fields may be omitted at a field boundary
+// ("2026-08-26", "2026-08-26T12:30"). Fields must already be in their
+// civil ranges; unlike the civil_second constructor, nothing here is
+// normalized.
+CONSTEXPR_F civil_second parse_civil_literal(const char* s, std::size_t len) {
+  const char* p = s;
+  const char* const end = s + len;
+  const bool neg = (p != end && *p == '-');
+  if (neg) ++p;
+  year_t y = 0;
+  int year_digits = 0;
+  while (p != end && '0' <= *p && *p <= '9') {
+    y = y * 10 + (*p++ - '0');
+    ++year_digits;
+  }
+  if (year_digits == 0 || year_digits > 18) {
+    return impl::bad_civil_literal("bad year");
+  }
+  if (neg) y = -y;
+  if (p == end) return civil_second(y, 1, 1, 0, 0, 0);
+  int m = 0;
+  if (*p++ != '-' || end - p < 2 || !impl::parse_digits(p, 2, &m) ||
+      m < 1 || m > 12) {
+    return impl::bad_civil_literal("bad month");
+  }
+  p += 2;
+  if (p == end) return civil_second(y, m, 1, 0, 0, 0);
+  int d = 0;
+  if (*p++ != '-' || end - p < 2 || !impl::parse_digits(p, 2, &d) ||
+      d < 1 || d > impl::days_per_month(y, static_cast<month_t>(m))) {
+    return impl::bad_civil_literal("bad day");
+  }
+  p += 2;
+  if (p == end) return civil_second(y, m, d, 0, 0, 0);
+  int hh = 0;
+  if ((*p != 'T' && *p != ' ') || (++p, end - p < 2) ||
+      !impl::parse_digits(p, 2, &hh) || hh > 23) {
+    return impl::bad_civil_literal("bad hour");
+  }
+  p += 2;
+  if (p == end) return civil_second(y, m, d, hh, 0, 0);
+  int mm = 0;
+  if (*p++ != ':' || end - p < 2 || !impl::parse_digits(p, 2, &mm) ||
+      mm > 59) {
+    return impl::bad_civil_literal("bad minute");
+  }
+  p += 2;
+  if (p == end) return civil_second(y, m, d, hh, mm, 0);
+  int ss = 0;
+  if (*p++ != ':' || end - p < 2 || !impl::parse_digits(p, 2, &ss) ||
+      ss > 59 || p + 2 != end) {
+    return impl::bad_civil_literal("bad second");
+  }
+  return civil_second(y, m, d, hh, mm, ss);
+}
+
+#endif  // C++14 constexpr
+
+////////////////////////////////////////////////////////////////////////
+
 std::ostream& operator<<(std::ostream& os, const civil_year& y);
 std::ostream& operator<<(std::ostream& os, const civil_month& m);
 std::ostream& operator<<(std::ostream& os, const civil_day& d);
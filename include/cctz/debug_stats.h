@@ -0,0 +1,71 @@
+// Copyright 2016 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   https://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+
+#ifndef CCTZ_DEBUG_STATS_H_
+#define CCTZ_DEBUG_STATS_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cctz {
+namespace debug {
+
+// Opt-in instrumentation for the library's hot paths, intended for
+// feeding a metrics exporter so that latency regressions (a lookup
+// pattern that defeats the transition hints, a format string that
+// silently hits the strftime() fallback) show up as counter movement.
+//
+// The counters exist only when the library is compiled with
+// -DCCTZ_ENABLE_STATS; in the default build the collection functions
+// below return false and the conversion/formatting paths contain no
+// instrumentation at all. Counts are accumulated with relaxed atomics,
+// so values read while other threads are converting are approximate.
+
+// Event counts for one time zone's conversion paths.
+struct zone_stats {
+  std::string zone_name;                      // e.g., "America/New_York"
+  std::uint_least64_t break_time_calls = 0;   // absolute-to-civil lookups
+  std::uint_least64_t break_time_hint_hits = 0;
+  std::uint_least64_t make_time_calls = 0;    // civil-to-absolute lookups
+  std::uint_least64_t make_time_hint_hits = 0;
+  std::uint_least64_t search_steps = 0;       // transition-search probes
+};
+
+// Event counts for the formatting/parsing paths.
+struct format_stats {
+  std::uint_least64_t format_calls = 0;
+  std::uint_least64_t format_strftime_fallbacks = 0;  // locale-dependent
+  std::uint_least64_t parse_calls = 0;
+  std::uint_least64_t parse_strptime_fallbacks = 0;   // locale-dependent
+};
+
+// Appends one zone_stats entry per loaded time zone. Returns true when
+// the library was compiled with CCTZ_ENABLE_STATS; otherwise returns
+// false and leaves *stats unmodified.
+bool zone_conversion_stats(std::vector<zone_stats>* stats);
+
+// Fills *stats with the process-wide formatting/parsing counts. Returns
+// true when the library was compiled with CCTZ_ENABLE_STATS; otherwise
+// returns false and leaves *stats unmodified.
+bool formatting_stats(format_stats* stats);
+
+// Zeroes all the counters, marking the start of a measurement interval.
+// A no-op unless the library was compiled with CCTZ_ENABLE_STATS.
+void reset_stats();
+
+}  // namespace debug
+}  // namespace cctz
+
+#endif  // CCTZ_DEBUG_STATS_H_
@@ -30,6 +30,15 @@ class ZoneInfoSource {
   virtual std::size_t Read(void* ptr, std::size_t size) = 0;  // like fread()
   virtual int Skip(std::size_t offset) = 0;  // like fseek()
 
+  // An optional, zero-copy alternative to Read().  Returns a pointer to
+  // the next "size" bytes of zoneinfo data and advances past them, or
+  // nullptr when borrowing is unsupported or too few bytes remain.  Any
+  // returned pointer is valid for the lifetime of the ZoneInfoSource.
+  // Sources backed by in-memory data (e.g., an mmap'd zoneinfo file)
+  // should override this so callers can parse the data in place.  The
+  // default implementation returns nullptr.
+  virtual const char* BorrowBytes(std::size_t size);
+
   // Until the zoneinfo data supports versioning information, we provide
   // a way for a ZoneInfoSource to indicate it out-of-band.  The default
   // implementation returns an empty string.
@@ -76,7 +85,11 @@ using ZoneInfoSourceFactory =
 // cctz_extension::zone_info_source_factory() will be called:
 //   (1) from the same thread as the cctz::load_time_zone() call,
 //   (2) only once for any zone name, and
-//   (3) serially (i.e., no concurrent execution).
+//   (3) serially (i.e., no concurrent execution),
+// except by cctz::load_time_zones(), which calls the factory from its
+// worker threads, possibly concurrently, and which may fetch a zone's
+// data a second time if that zone is simultaneously being loaded by
+// load_time_zone().
 //
 // The fallback factory obtains zoneinfo data by reading files in ${TZDIR},
 // and it is used automatically when no zone_info_source_factory definition
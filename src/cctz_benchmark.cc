@@ -53,6 +53,32 @@ void BM_GetWeekday(benchmark::State& state) {
 }
 BENCHMARK(BM_GetWeekday);
 
+void BM_GetWeekdayBatch(benchmark::State& state) {
+  std::vector<cctz::civil_day> days;
+  for (cctz::civil_day c(2014, 1, 1); c < cctz::civil_day(2015, 1, 1); ++c) {
+    days.push_back(c);
+  }
+  std::vector<cctz::weekday> wds(days.size());
+  while (state.KeepRunningBatch(days.size())) {
+    cctz::get_weekday(days.data(), days.size(), wds.data());
+    benchmark::DoNotOptimize(wds.data());
+  }
+}
+BENCHMARK(BM_GetWeekdayBatch);
+
+void BM_GetYeardayBatch(benchmark::State& state) {
+  std::vector<cctz::civil_day> days;
+  for (cctz::civil_day c(2014, 1, 1); c < cctz::civil_day(2015, 1, 1); ++c) {
+    days.push_back(c);
+  }
+  std::vector<int> ydays(days.size());
+  while (state.KeepRunningBatch(days.size())) {
+    cctz::get_yearday(days.data(), days.size(), ydays.data());
+    benchmark::DoNotOptimize(ydays.data());
+  }
+}
+BENCHMARK(BM_GetYeardayBatch);
+
 void BM_NextWeekday(benchmark::State& state) {
   const cctz::civil_day kStart(2014, 8, 22);
   const cctz::civil_day kDays[7] = {
@@ -890,6 +916,25 @@ void BM_Time_ToCivilUTC_Libc(benchmark::State& state) {
 }
 BENCHMARK(BM_Time_ToCivilUTC_Libc);
 
+// Here successive instants fall on opposite sides of a DST transition,
+// so the interval remembered from each lookup is always wrong for the
+// next one and every lookup must re-search. This is the worst case for
+// the transition hints (see local_time_hint_).
+void BM_Time_ToCivilAdversarial_CCTZ(benchmark::State& state) {
+  const cctz::time_zone tz = TestTimeZone();
+  // 30 seconds either side of the 2011-03-13 02:00 spring-forward
+  // transition in America/Los_Angeles.
+  std::chrono::system_clock::time_point tp =
+      cctz::convert(cctz::civil_second(2011, 3, 13, 1, 59, 30), tz);
+  std::chrono::system_clock::time_point tp2 =
+      cctz::convert(cctz::civil_second(2011, 3, 13, 3, 0, 30), tz);
+  while (state.KeepRunning()) {
+    std::swap(tp, tp2);
+    benchmark::DoNotOptimize(cctz::convert(tp, tz));
+  }
+}
+BENCHMARK(BM_Time_ToCivilAdversarial_CCTZ);
+
 // In each "FromCivil" benchmark we switch between two YMDhms values
 // separated by at least one transition in order to defeat any internal
 // caching of previous results (e.g., see time_local_hint_).
@@ -990,6 +1035,23 @@ void BM_Time_FromCivilDay0_Libc(benchmark::State& state) {
 }
 BENCHMARK(BM_Time_FromCivilDay0_Libc);
 
+// The civil-time analog of BM_Time_ToCivilAdversarial_CCTZ: alternating
+// conversions either side of a DST transition defeat time_local_hint_.
+void BM_Time_FromCivilAdversarial_CCTZ(benchmark::State& state) {
+  const cctz::time_zone tz = TestTimeZone();
+  int i = 0;
+  while (state.KeepRunning()) {
+    if ((i++ & 1) == 0) {
+      benchmark::DoNotOptimize(
+          cctz::convert(cctz::civil_second(2011, 3, 13, 1, 59, 30), tz));
+    } else {
+      benchmark::DoNotOptimize(
+          cctz::convert(cctz::civil_second(2011, 3, 13, 3, 0, 30), tz));
+    }
+  }
+}
+BENCHMARK(BM_Time_FromCivilAdversarial_CCTZ);
+
 const char* const kFormats[] = {
     RFC1123_full,         // 0
     RFC1123_no_wday,      // 1
@@ -1027,4 +1089,119 @@ void BM_Format_ParseTime(benchmark::State& state) {
 }
 BENCHMARK(BM_Format_ParseTime)->DenseRange(0, kNumFormats - 1);
 
+// The "Compiled" variants use cctz::formatter/cctz::parser so that the
+// per-call specification scanning of the benchmarks above is hoisted
+// out of the loop. The "Cached" variant adds cctz::cached_formatter's
+// same-second render cache (every iteration here hits it).
+
+void BM_Format_FormatTimeCompiled(benchmark::State& state) {
+  const std::string fmt = kFormats[state.range(0)];
+  state.SetLabel(fmt);
+  const cctz::time_zone tz = TestTimeZone();
+  const cctz::formatter formatter(fmt);
+  const std::chrono::system_clock::time_point tp =
+      cctz::convert(cctz::civil_second(1977, 6, 28, 9, 8, 7), tz) +
+      std::chrono::microseconds(1);
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(formatter.format(tp, tz));
+  }
+}
+BENCHMARK(BM_Format_FormatTimeCompiled)->DenseRange(0, kNumFormats - 1);
+
+void BM_Format_FormatTimeCached(benchmark::State& state) {
+  const std::string fmt = kFormats[state.range(0)];
+  state.SetLabel(fmt);
+  const cctz::time_zone tz = TestTimeZone();
+  cctz::cached_formatter formatter(fmt);
+  const std::chrono::system_clock::time_point tp =
+      cctz::convert(cctz::civil_second(1977, 6, 28, 9, 8, 7), tz) +
+      std::chrono::microseconds(1);
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(formatter.format(tp, tz));
+  }
+}
+BENCHMARK(BM_Format_FormatTimeCached)->DenseRange(0, kNumFormats - 1);
+
+void BM_Format_ParseTimeCompiled(benchmark::State& state) {
+  const std::string fmt = kFormats[state.range(0)];
+  state.SetLabel(fmt);
+  const cctz::time_zone tz = TestTimeZone();
+  const cctz::parser parser(fmt);
+  std::chrono::system_clock::time_point tp =
+      cctz::convert(cctz::civil_second(1977, 6, 28, 9, 8, 7), tz) +
+      std::chrono::microseconds(1);
+  const std::string when = cctz::format(fmt, tp, tz);
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(parser.parse(when, tz, &tp));
+  }
+}
+BENCHMARK(BM_Format_ParseTimeCompiled)->DenseRange(0, kNumFormats - 1);
+
+// The "Threads" benchmarks run the steady-state paths from multiple
+// threads sharing one time_zone handle, to expose contention that the
+// single-threaded benchmarks above cannot: cross-thread traffic on the
+// zone map and on any shared lookup state.
+
+void BM_Threads_ToCivil_CCTZ(benchmark::State& state) {
+  const cctz::time_zone tz = TestTimeZone();
+  std::chrono::system_clock::time_point tp =
+      std::chrono::system_clock::from_time_t(1384569027);
+  std::chrono::system_clock::time_point tp2 =
+      std::chrono::system_clock::from_time_t(1418962578);
+  while (state.KeepRunning()) {
+    std::swap(tp, tp2);
+    tp += std::chrono::seconds(1);
+    benchmark::DoNotOptimize(cctz::convert(tp, tz));
+  }
+}
+BENCHMARK(BM_Threads_ToCivil_CCTZ)->ThreadRange(1, 16);
+
+void BM_Threads_ToCivilAdversarial_CCTZ(benchmark::State& state) {
+  const cctz::time_zone tz = TestTimeZone();
+  std::chrono::system_clock::time_point tp =
+      cctz::convert(cctz::civil_second(2011, 3, 13, 1, 59, 30), tz);
+  std::chrono::system_clock::time_point tp2 =
+      cctz::convert(cctz::civil_second(2011, 3, 13, 3, 0, 30), tz);
+  while (state.KeepRunning()) {
+    std::swap(tp, tp2);
+    benchmark::DoNotOptimize(cctz::convert(tp, tz));
+  }
+}
+BENCHMARK(BM_Threads_ToCivilAdversarial_CCTZ)->ThreadRange(1, 16);
+
+void BM_Threads_FormatTime(benchmark::State& state) {
+  const std::string fmt = RFC3339_full;
+  const cctz::time_zone tz = TestTimeZone();
+  const std::chrono::system_clock::time_point tp =
+      cctz::convert(cctz::civil_second(1977, 6, 28, 9, 8, 7), tz) +
+      std::chrono::microseconds(1);
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(cctz::format(fmt, tp, tz));
+  }
+}
+BENCHMARK(BM_Threads_FormatTime)->ThreadRange(1, 16);
+
+void BM_Threads_ParseTime(benchmark::State& state) {
+  const std::string fmt = RFC3339_full;
+  const cctz::time_zone tz = TestTimeZone();
+  std::chrono::system_clock::time_point tp =
+      cctz::convert(cctz::civil_second(1977, 6, 28, 9, 8, 7), tz) +
+      std::chrono::microseconds(1);
+  const std::string when = cctz::format(fmt, tp, tz);
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(cctz::parse(fmt, when, tz, &tp));
+  }
+}
+BENCHMARK(BM_Threads_ParseTime)->ThreadRange(1, 16);
+
+void BM_Threads_LoadTimeZoneCached(benchmark::State& state) {
+  cctz::time_zone tz = cctz::utc_time_zone();  // in case we're first
+  const std::string name = "file:America/Los_Angeles";
+  cctz::load_time_zone(name, &tz);  // prime cache
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(cctz::load_time_zone(name, &tz));
+  }
+}
+BENCHMARK(BM_Threads_LoadTimeZoneCached)->ThreadRange(1, 16);
+
 }  // namespace
@@ -14,11 +14,13 @@
 
 #include "cctz/civil_time.h"
 
+#include <cstddef>
 #include <iomanip>
 #include <limits>
 #include <sstream>
 #include <string>
 #include <type_traits>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -317,10 +319,54 @@ TEST(CivilTime, YearDay) {
   constexpr int yd = get_yearday(cd);
   static_assert(yd == 28, "YearDay");
 }
+
+TEST(CivilTime, Literal) {
+  using namespace cctz::literals;
+  constexpr civil_second cs = "2016-01-28T17:14:12"_civil;
+  static_assert(cs == civil_second(2016, 1, 28, 17, 14, 12), "Literal.full");
+  constexpr civil_second sp = "2016-01-28 17:14:12"_civil;
+  static_assert(sp == cs, "Literal.space");
+  static_assert("2016-01-28T17:14"_civil ==
+                    civil_second(2016, 1, 28, 17, 14, 0),
+                "Literal.minute");
+  static_assert("2016-01-28T17"_civil == civil_second(2016, 1, 28, 17, 0, 0),
+                "Literal.hour");
+  static_assert("2016-01-28"_civil == civil_second(2016, 1, 28, 0, 0, 0),
+                "Literal.day");
+  static_assert("2016-01"_civil == civil_second(2016, 1, 1, 0, 0, 0),
+                "Literal.month");
+  static_assert("2016"_civil == civil_second(2016, 1, 1, 0, 0, 0),
+                "Literal.year");
+  static_assert("-9-12-31T23:59:59"_civil ==
+                    civil_second(-9, 12, 31, 23, 59, 59),
+                "Literal.negative");
+  static_assert("2016-02-29"_civil == civil_second(2016, 2, 29, 0, 0, 0),
+                "Literal.leap");
+}
 #endif  // __cpp_constexpr >= 201304 || (defined(_MSC_VER) && _MSC_VER >= 1910)
 
 // The remaining tests do not use constexpr.
 
+TEST(CivilTime, BatchWeekdayYearday) {
+  // The batch kernels must agree with their scalar counterparts,
+  // including across leap years, century boundaries, and negative
+  // years.
+  std::vector<civil_day> days;
+  for (const year_t y : {-400, -1, 0, 1899, 1900, 1970, 2000, 2016, 2400}) {
+    for (civil_day cd(y, 1, 1); cd < civil_year(y + 1); cd += 17) {
+      days.push_back(cd);
+    }
+  }
+  std::vector<weekday> wds(days.size());
+  get_weekday(days.data(), days.size(), wds.data());
+  std::vector<int> ydays(days.size());
+  get_yearday(days.data(), days.size(), ydays.data());
+  for (std::size_t i = 0; i != days.size(); ++i) {
+    EXPECT_EQ(get_weekday(days[i]), wds[i]) << days[i];
+    EXPECT_EQ(get_yearday(days[i]), ydays[i]) << days[i];
+  }
+}
+
 TEST(CivilTime, DefaultConstruction) {
   civil_second ss;
   EXPECT_EQ("1970-01-01T00:00:00", Format(ss));
@@ -0,0 +1,75 @@
+// Copyright 2016 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   https://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+
+#ifndef CCTZ_DEBUG_STATS_INTERNAL_H_
+#define CCTZ_DEBUG_STATS_INTERNAL_H_
+
+#include "cctz/debug_stats.h"
+
+#if defined(CCTZ_ENABLE_STATS)
+#include <atomic>
+#include <cstdint>
+#endif
+
+namespace cctz {
+
+#if defined(CCTZ_ENABLE_STATS)
+
+// One event counter. Increments are relaxed: the counts feed metrics,
+// not logic, so losing ordering against the events they describe is
+// fine, and the hot paths pay only an uncontended atomic add.
+class StatsCounter {
+ public:
+  void Increment(std::uint_least64_t n = 1) {
+    value_.fetch_add(n, std::memory_order_relaxed);
+  }
+  std::uint_least64_t Value() const {
+    return value_.load(std::memory_order_relaxed);
+  }
+  void Reset() { value_.store(0, std::memory_order_relaxed); }
+
+ private:
+  std::atomic<std::uint_least64_t> value_{0};
+};
+
+// The per-zone counters embedded in each TimeZoneInfo. See the
+// debug::zone_stats fields they populate for descriptions.
+struct ConversionCounters {
+  StatsCounter break_time_calls;
+  StatsCounter break_time_hint_hits;
+  StatsCounter make_time_calls;
+  StatsCounter make_time_hint_hits;
+  StatsCounter search_steps;
+};
+
+// Counts an event. Compiles to nothing (and does not evaluate its
+// arguments) unless built with CCTZ_ENABLE_STATS.
+#define CCTZ_STATS_COUNT(counter) (counter).Increment()
+#define CCTZ_STATS_ADD(counter, n) (counter).Increment(n)
+
+#else  // !defined(CCTZ_ENABLE_STATS)
+
+#define CCTZ_STATS_COUNT(counter) (static_cast<void>(0))
+#define CCTZ_STATS_ADD(counter, n) (static_cast<void>(0))
+
+#endif  // defined(CCTZ_ENABLE_STATS)
+
+// Resets the formatting/parsing counters owned by time_zone_format.cc,
+// for debug::reset_stats(). The per-zone counters are reset through
+// time_zone::Impl.
+void ResetFormatStats();
+
+}  // namespace cctz
+
+#endif  // CCTZ_DEBUG_STATS_INTERNAL_H_
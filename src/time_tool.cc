@@ -14,9 +14,18 @@
 
 // A command-line tool for exercising the CCTZ library.
 
+#if defined(_MSC_VER)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
 #include <algorithm>
 #include <cctype>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <ctime>
 #include <iomanip>
@@ -28,6 +37,7 @@
 
 #include "cctz/civil_time.h"
 #include "cctz/time_zone.h"
+#include "time_zone_info.h"
 
 // Pulls in the aliases from cctz for brevity.
 template <typename D>
@@ -231,6 +241,387 @@ void ZoneDump(bool zdump, const std::string& fmt, cctz::time_zone zone,
   }
 }
 
+// Creates the directory (and any missing parents), like mkdir -p.
+bool MakeDirs(const std::string& path) {
+  for (std::string::size_type pos = 1; pos != std::string::npos;) {
+    pos = path.find('/', pos);
+    const std::string dir = path.substr(0, pos);
+    if (pos != std::string::npos) ++pos;
+#if defined(_MSC_VER)
+    _mkdir(dir.c_str());  // may already exist
+#else
+    mkdir(dir.c_str(), 0777);  // may already exist
+#endif
+  }
+  return true;
+}
+
+// Writes a compiled-zone cache record (see TimeZoneInfo) for each of
+// the named zones into <dir>/<name>, for use with ${CCTZ_ZONE_CACHE_DIR}.
+int CompileZoneCache(const std::string& dir,
+                     const std::vector<std::string>& zones) {
+  for (const std::string& name : zones) {
+    cctz::TimeZoneInfo info;
+    if (!info.Load(name)) {
+      std::cerr << name << ": Unrecognized time zone\n";
+      return 1;
+    }
+    std::string record;
+    if (!info.SerializeCompiledCache(&record)) {
+      std::cerr << name << ": Failed to serialize zone\n";
+      return 1;
+    }
+    const std::string path = dir + "/" + name;
+    const std::string::size_type slash = path.rfind('/');
+    MakeDirs(path.substr(0, slash));
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (fp == nullptr ||
+        fwrite(record.data(), 1, record.size(), fp) != record.size()) {
+      std::cerr << path << ": Failed to write cache file\n";
+      if (fp != nullptr) fclose(fp);
+      return 1;
+    }
+    fclose(fp);
+  }
+  return 0;
+}
+
+// Writes a shared-arena image (see TimeZoneInfo) for each of the named
+// zones into <dir>/<name>, for use with ${CCTZ_SHARED_ZONE_DIR}. The
+// directory is typically on a tmpfs (e.g., /dev/shm) so that every
+// process on the host maps one physical copy of the zone data.
+int ShareZoneCache(const std::string& dir,
+                   const std::vector<std::string>& zones) {
+  for (const std::string& name : zones) {
+    cctz::TimeZoneInfo info;
+    if (!info.Load(name)) {
+      std::cerr << name << ": Unrecognized time zone\n";
+      return 1;
+    }
+    std::string image;
+    if (!info.SerializeArenaImage(&image)) {
+      std::cerr << name << ": Failed to serialize zone\n";
+      return 1;
+    }
+    const std::string path = dir + "/" + name;
+    const std::string::size_type slash = path.rfind('/');
+    MakeDirs(path.substr(0, slash));
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (fp == nullptr ||
+        fwrite(image.data(), 1, image.size(), fp) != image.size()) {
+      std::cerr << path << ": Failed to write image file\n";
+      if (fp != nullptr) fclose(fp);
+      return 1;
+    }
+    fclose(fp);
+  }
+  return 0;
+}
+
+// Maps a zone name to its zoneinfo file, mirroring the resolution
+// performed by the library's fallback ZoneInfoSource.
+std::string ZoneInfoPath(const std::string& name) {
+  if (!name.empty() && name[0] == '/') return name;
+  const char* tzdir = "/usr/share/zoneinfo";
+  const char* tzdir_env = std::getenv("TZDIR");
+  if (tzdir_env != nullptr && *tzdir_env != '\0') tzdir = tzdir_env;
+  return std::string(tzdir) + "/" + name;
+}
+
+// Writes a C++ translation unit that embeds the raw zoneinfo data for
+// the named zones as constant (.rodata) arrays, and that defines
+// cctz_extension::zone_info_source_factory to serve Load() directly
+// from those arrays, falling back to the usual sources for anything
+// not embedded. Linking the generated file into a program removes its
+// runtime dependency on a zoneinfo directory for the chosen zones.
+int EmbedZones(const std::string& path, std::vector<std::string> zones) {
+  std::sort(zones.begin(), zones.end());
+  zones.erase(std::unique(zones.begin(), zones.end()), zones.end());
+
+  std::ostringstream out;
+  out << "// Generated by time_tool --embed_zones. DO NOT EDIT.\n"
+      << "\n"
+      << "#include <cstddef>\n"
+      << "#include <cstring>\n"
+      << "#include <functional>\n"
+      << "#include <memory>\n"
+      << "#include <string>\n"
+      << "\n"
+      << "#include \"cctz/zone_info_source.h\"\n"
+      << "\n"
+      << "namespace {\n";
+
+  std::string version;
+  for (std::size_t i = 0; i != zones.size(); ++i) {
+    const std::string& name = zones[i];
+    cctz::TimeZoneInfo info;
+    if (!info.Load(name)) {
+      std::cerr << name << ": Unrecognized time zone\n";
+      return 1;
+    }
+    if (version.empty()) version = info.Version();
+    FILE* fp = fopen(ZoneInfoPath(name).c_str(), "rb");
+    if (fp == nullptr) {
+      std::cerr << name << ": Failed to open zoneinfo file\n";
+      return 1;
+    }
+    std::string data;
+    char buf[4096];
+    while (std::size_t nread = fread(buf, 1, sizeof(buf), fp)) {
+      data.append(buf, nread);
+    }
+    fclose(fp);
+    out << "\n// " << name << "\nconst unsigned char kZoneData" << i
+        << "[] = {";
+    for (std::size_t j = 0; j != data.size(); ++j) {
+      if (j % 12 == 0) out << "\n   ";
+      char hex[8];
+      std::snprintf(hex, sizeof(hex), " 0x%02x,",
+                    static_cast<unsigned char>(data[j]));
+      out << hex;
+    }
+    out << "\n};\n";
+  }
+
+  out << "\n"
+      << "const char kEmbeddedVersion[] = \"" << version << "\";\n"
+      << "\n"
+      << "struct EmbeddedZone {\n"
+      << "  const char* name;\n"
+      << "  const unsigned char* data;\n"
+      << "  std::size_t size;\n"
+      << "};\n"
+      << "\n"
+      << "// Sorted by name for binary search.\n"
+      << "const EmbeddedZone kEmbeddedZones[] = {\n";
+  for (std::size_t i = 0; i != zones.size(); ++i) {
+    out << "    {\"" << zones[i] << "\", kZoneData" << i << ", sizeof(kZoneData"
+        << i << ")},\n";
+  }
+  out << "};\n"
+      << "\n"
+      << "// Serves zoneinfo data directly from the embedded arrays.\n"
+      << "class EmbeddedZoneInfoSource : public cctz::ZoneInfoSource {\n"
+      << " public:\n"
+      << "  EmbeddedZoneInfoSource(const unsigned char* data, std::size_t "
+         "size)\n"
+      << "      : data_(reinterpret_cast<const char*>(data)), size_(size) {}\n"
+      << "  std::size_t Read(void* ptr, std::size_t size) override {\n"
+      << "    if (size > size_ - off_) size = size_ - off_;\n"
+      << "    std::memcpy(ptr, data_ + off_, size);\n"
+      << "    off_ += size;\n"
+      << "    return size;\n"
+      << "  }\n"
+      << "  int Skip(std::size_t offset) override {\n"
+      << "    if (offset > size_ - off_) offset = size_ - off_;\n"
+      << "    off_ += offset;\n"
+      << "    return 0;\n"
+      << "  }\n"
+      << "  const char* BorrowBytes(std::size_t size) override {\n"
+      << "    if (size > size_ - off_) return nullptr;\n"
+      << "    const char* p = data_ + off_;\n"
+      << "    off_ += size;\n"
+      << "    return p;\n"
+      << "  }\n"
+      << "  std::string Version() const override { return kEmbeddedVersion; "
+         "}\n"
+      << "\n"
+      << " private:\n"
+      << "  const char* const data_;\n"
+      << "  const std::size_t size_;\n"
+      << "  std::size_t off_ = 0;\n"
+      << "};\n"
+      << "\n"
+      << "std::unique_ptr<cctz::ZoneInfoSource> EmbeddedFactory(\n"
+      << "    const std::string& name,\n"
+      << "    const std::function<std::unique_ptr<cctz::ZoneInfoSource>(\n"
+      << "        const std::string& name)>& fallback_factory) {\n"
+      << "  std::size_t lo = 0;\n"
+      << "  std::size_t hi = sizeof(kEmbeddedZones) / "
+         "sizeof(kEmbeddedZones[0]);\n"
+      << "  while (lo != hi) {\n"
+      << "    const std::size_t mid = lo + (hi - lo) / 2;\n"
+      << "    const int cmp = std::strcmp(name.c_str(), "
+         "kEmbeddedZones[mid].name);\n"
+      << "    if (cmp == 0) {\n"
+      << "      return std::unique_ptr<cctz::ZoneInfoSource>(\n"
+      << "          new EmbeddedZoneInfoSource(kEmbeddedZones[mid].data,\n"
+      << "                                     kEmbeddedZones[mid].size));\n"
+      << "    }\n"
+      << "    if (cmp < 0) {\n"
+      << "      hi = mid;\n"
+      << "    } else {\n"
+      << "      lo = mid + 1;\n"
+      << "    }\n"
+      << "  }\n"
+      << "  return fallback_factory(name);\n"
+      << "}\n"
+      << "\n"
+      << "}  // namespace\n"
+      << "\n"
+      << "namespace cctz_extension {\n"
+      << "ZoneInfoSourceFactory zone_info_source_factory = EmbeddedFactory;\n"
+      << "}  // namespace cctz_extension\n";
+
+  const std::string tu = out.str();
+  FILE* fp = (path == "-") ? stdout : fopen(path.c_str(), "wb");
+  if (fp == nullptr ||
+      fwrite(tu.data(), 1, tu.size(), fp) != tu.size()) {
+    std::cerr << path << ": Failed to write embedded zone data\n";
+    if (fp != nullptr && fp != stdout) fclose(fp);
+    return 1;
+  }
+  if (fp != stdout) fclose(fp);
+  return 0;
+}
+
+// Writes a concatenated, indexed tzdata archive containing the named
+// zones, for use via ${CCTZ_TZDATA} (or installed as <TZDIR>/tzdata.cctz).
+// The library serves every contained zone from that one file, opened
+// and mapped just once per process. See TzdataArchive in
+// time_zone_info.cc for the format.
+int BuildTzdataArchive(const std::string& path,
+                       std::vector<std::string> zones) {
+  std::sort(zones.begin(), zones.end());
+  zones.erase(std::unique(zones.begin(), zones.end()), zones.end());
+
+  // Multi-byte values are encoded MSB first, like the TZif encoding.
+  const auto encode32 = [](std::string* out, std::size_t v) {
+    for (int shift = 24; shift >= 0; shift -= 8) {
+      out->push_back(static_cast<char>((v >> shift) & 0xff));
+    }
+  };
+
+  std::string version;
+  std::string index;
+  std::string data;
+  for (const std::string& name : zones) {
+    if (name.size() >= 40) {
+      std::cerr << name << ": Zone name too long for archive index\n";
+      return 1;
+    }
+    cctz::TimeZoneInfo info;
+    if (!info.Load(name)) {
+      std::cerr << name << ": Unrecognized time zone\n";
+      return 1;
+    }
+    if (version.empty()) version = info.Version();
+    FILE* fp = fopen(ZoneInfoPath(name).c_str(), "rb");
+    if (fp == nullptr) {
+      std::cerr << name << ": Failed to open zoneinfo file\n";
+      return 1;
+    }
+    std::string tzif;
+    char buf[4096];
+    while (std::size_t nread = fread(buf, 1, sizeof(buf), fp)) {
+      tzif.append(buf, nread);
+    }
+    fclose(fp);
+    index.append(name);               // sorted for binary search
+    index.append(40 - name.size(), '\0');
+    encode32(&index, data.size());
+    encode32(&index, tzif.size());
+    data += tzif;
+  }
+
+  std::string archive("tzarchv1");
+  encode32(&archive, zones.size());
+  version.resize(12, '\0');  // NUL padded
+  archive += version;
+  archive += index;
+  archive += data;
+
+  FILE* fp = fopen(path.c_str(), "wb");
+  if (fp == nullptr ||
+      fwrite(archive.data(), 1, archive.size(), fp) != archive.size()) {
+    std::cerr << path << ": Failed to write tzdata archive\n";
+    if (fp != nullptr) fclose(fp);
+    return 1;
+  }
+  fclose(fp);
+  return 0;
+}
+
+// Runs as a stream filter: reads timestamps from stdin, one per line,
+// and writes the corresponding formatted civil time in the given zone
+// to stdout, one per line. A timestamp is decimal (integer) seconds
+// since the Unix epoch, optionally prefixed with '@'. The format
+// specification is compiled once and I/O is done in large blocks, so a
+// single invocation can stream millions of conversions per second
+// inside a data pipeline, e.g.
+//
+//   cut -d, -f3 events.csv | time_tool --tz=America/New_York --filter
+//
+// A malformed line yields an empty output line (keeping the input and
+// output line-aligned), with a count reported on stderr at the end.
+int FilterTimes(const std::string& fmt, cctz::time_zone zone) {
+  const cctz::formatter formatter(fmt);
+  const time_point<seconds> unix_epoch = std::chrono::time_point_cast<seconds>(
+      std::chrono::system_clock::from_time_t(0));
+
+  std::vector<char> in(1 << 16);
+  std::string pending;  // a partial line carried between blocks
+  std::string out;
+  long long bad = 0;
+
+  auto convert_line = [&](const char* p, const char* end) {
+    if (end != p && end[-1] == '\r') --end;  // allow CRLF input
+    if (p != end && *p == '@') ++p;
+    const bool neg = (p != end && *p == '-');
+    if (neg) ++p;
+    const char* const digits = p;
+    std::int_fast64_t v = 0;
+    while (p != end && '0' <= *p && *p <= '9') v = v * 10 + (*p++ - '0');
+    if (p == digits || p != end) {
+      ++bad;  // not a timestamp; leave the output line empty
+    } else {
+      const time_point<seconds> tp = unix_epoch + seconds(neg ? -v : v);
+      char buf[256];
+      if (const std::size_t len =
+              formatter.format_to(tp, zone, buf, sizeof(buf))) {
+        out.append(buf, len);
+      } else {  // the rendering exceeds buf
+        out.append(formatter.format(tp, zone));
+      }
+    }
+    out.push_back('\n');
+  };
+  auto flush = [&out]() {
+    if (!out.empty()) {
+      std::fwrite(out.data(), 1, out.size(), stdout);
+      out.clear();
+    }
+  };
+
+  while (const std::size_t n = std::fread(&in[0], 1, in.size(), stdin)) {
+    const char* p = &in[0];
+    const char* const end = p + n;
+    while (const char* nl = static_cast<const char*>(
+               std::memchr(p, '\n', static_cast<std::size_t>(end - p)))) {
+      if (pending.empty()) {
+        convert_line(p, nl);
+      } else {
+        pending.append(p, nl);
+        convert_line(pending.data(), pending.data() + pending.size());
+        pending.clear();
+      }
+      p = nl + 1;
+      if (out.size() >= (1 << 15)) flush();
+    }
+    pending.append(p, end);
+  }
+  if (!pending.empty()) {  // an unterminated final line
+    convert_line(pending.data(), pending.data() + pending.size());
+  }
+  flush();
+
+  if (bad != 0) {
+    std::cerr << bad << " malformed input line(s)\n";
+    return 1;
+  }
+  return 0;
+}
+
 const char* Basename(const char* p) {
   if (const char* b = std::strrchr(p, '/')) return ++b;
   return p;
@@ -315,6 +706,11 @@ int main(int argc, const char** argv) {
   // Determine the time zone and other options.
   std::string zones = "localtime";
   std::string fmt = "%Y-%m-%d %H:%M:%S %E*z (%Z)";
+  std::string cache_dir;
+  std::string share_dir;
+  std::string embed_file;
+  std::string archive_file;
+  bool filter = false;
   bool zone_dump = (prog == "zone_dump");
   bool zdump = false;  // Use zdump(8) format.
   int optind = 0;
@@ -379,6 +775,48 @@ int main(int argc, const char** argv) {
         }
       } else if (std::strncmp(opt, "fmt=", 4) == 0) {
         fmt = opt + 4;
+      } else if (std::strcmp(opt, "compile_zone_cache") == 0) {
+        if (optind + 1 == argc) {
+          std::cerr << argv0
+                    << ": option '--compile_zone_cache' requires an argument\n";
+          ++opterr;
+        } else {
+          cache_dir = argv[++optind];
+        }
+      } else if (std::strncmp(opt, "compile_zone_cache=", 19) == 0) {
+        cache_dir = opt + 19;
+      } else if (std::strcmp(opt, "share_zone_cache") == 0) {
+        if (optind + 1 == argc) {
+          std::cerr << argv0
+                    << ": option '--share_zone_cache' requires an argument\n";
+          ++opterr;
+        } else {
+          share_dir = argv[++optind];
+        }
+      } else if (std::strncmp(opt, "share_zone_cache=", 17) == 0) {
+        share_dir = opt + 17;
+      } else if (std::strcmp(opt, "embed_zones") == 0) {
+        if (optind + 1 == argc) {
+          std::cerr << argv0
+                    << ": option '--embed_zones' requires an argument\n";
+          ++opterr;
+        } else {
+          embed_file = argv[++optind];
+        }
+      } else if (std::strncmp(opt, "embed_zones=", 12) == 0) {
+        embed_file = opt + 12;
+      } else if (std::strcmp(opt, "build_tzdata_archive") == 0) {
+        if (optind + 1 == argc) {
+          std::cerr << argv0 << ": option '--build_tzdata_archive'"
+                    << " requires an argument\n";
+          ++opterr;
+        } else {
+          archive_file = argv[++optind];
+        }
+      } else if (std::strncmp(opt, "build_tzdata_archive=", 21) == 0) {
+        archive_file = opt + 21;
+      } else if (std::strcmp(opt, "filter") == 0) {
+        filter = true;
       } else if (std::strcmp(opt, "zdump") == 0) {
         zdump = true;
       } else if (std::strcmp(opt, "zone_dump") == 0) {
@@ -402,6 +840,32 @@ int main(int argc, const char** argv) {
     return 1;
   }
 
+  if (!cache_dir.empty()) {
+    return CompileZoneCache(cache_dir, StrSplit(',', zones));
+  }
+  if (!share_dir.empty()) {
+    return ShareZoneCache(share_dir, StrSplit(',', zones));
+  }
+  if (!embed_file.empty()) {
+    return EmbedZones(embed_file, StrSplit(',', zones));
+  }
+  if (!archive_file.empty()) {
+    return BuildTzdataArchive(archive_file, StrSplit(',', zones));
+  }
+  if (filter) {
+    const std::vector<std::string> zone_names = StrSplit(',', zones);
+    if (zone_names.size() != 1) {
+      std::cerr << argv0 << ": --filter converts into a single time zone\n";
+      return 1;
+    }
+    cctz::time_zone zone;
+    if (!cctz::load_time_zone(zone_names[0], &zone)) {
+      std::cerr << zone_names[0] << ": Unrecognized time zone\n";
+      return 1;
+    }
+    return FilterTimes(fmt, zone);
+  }
+
   std::string args;
   for (int i = optind; i < argc; ++i) {
     if (i != optind) args += " ";
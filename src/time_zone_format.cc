@@ -37,6 +37,7 @@
 #include <cstring>
 #include <ctime>
 #include <limits>
+#include <memory>
 #include <string>
 #include <vector>
 #if !HAS_STRPTIME
@@ -45,9 +46,23 @@
 #endif
 
 #include "cctz/civil_time.h"
+#include "debug_stats.h"
 #include "time_zone_if.h"
 
 namespace cctz {
+
+#if defined(CCTZ_ENABLE_STATS)
+namespace {
+
+// Process-wide formatting/parsing counters. See cctz/debug_stats.h.
+StatsCounter format_call_count;
+StatsCounter format_strftime_fallback_count;
+StatsCounter parse_call_count;
+StatsCounter parse_strptime_fallback_count;
+
+}  // namespace
+#endif
+
 namespace detail {
 
 namespace {
@@ -63,6 +78,27 @@ char* strptime(const char* s, const char* fmt, std::tm* tm) {
 }
 #endif
 
+// Maps a cctz::weekday to the std::tm convention (Sun=0 ... Sat=6).
+int ToTmWday(weekday wd) {
+  switch (wd) {
+    case weekday::sunday:
+      return 0;
+    case weekday::monday:
+      return 1;
+    case weekday::tuesday:
+      return 2;
+    case weekday::wednesday:
+      return 3;
+    case weekday::thursday:
+      return 4;
+    case weekday::friday:
+      return 5;
+    case weekday::saturday:
+      return 6;
+  }
+  return 0;  // unreachable
+}
+
 std::tm ToTM(const time_zone::absolute_lookup& al) {
   std::tm tm{};
   tm.tm_sec = al.cs.second();
@@ -80,29 +116,7 @@ std::tm ToTM(const time_zone::absolute_lookup& al) {
     tm.tm_year = static_cast<int>(al.cs.year() - 1900);
   }
 
-  switch (get_weekday(al.cs)) {
-    case weekday::sunday:
-      tm.tm_wday = 0;
-      break;
-    case weekday::monday:
-      tm.tm_wday = 1;
-      break;
-    case weekday::tuesday:
-      tm.tm_wday = 2;
-      break;
-    case weekday::wednesday:
-      tm.tm_wday = 3;
-      break;
-    case weekday::thursday:
-      tm.tm_wday = 4;
-      break;
-    case weekday::friday:
-      tm.tm_wday = 5;
-      break;
-    case weekday::saturday:
-      tm.tm_wday = 6;
-      break;
-  }
+  tm.tm_wday = ToTmWday(get_weekday(al.cs));
   tm.tm_yday = get_yearday(al.cs) - 1;
   tm.tm_isdst = al.is_dst ? 1 : 0;
   return tm;
@@ -110,6 +124,66 @@ std::tm ToTM(const time_zone::absolute_lookup& al) {
 
 const char kDigits[] = "0123456789";
 
+// All two-digit numbers in order, so that a single table lookup emits a
+// zero-padded digit pair. See Format02d() and Format64().
+const char kTwoDigits[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// Fixed C-locale names used when formatting %a/%A/%b/%B/%h/%p and the
+// composite specifiers, so no standard conversion ever has to consult
+// the process locale via strftime(3).
+const char* const kWeekdayShort[7] = {
+    "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat",
+};
+const char* const kWeekdayFull[7] = {
+    "Sunday",   "Monday", "Tuesday", "Wednesday",
+    "Thursday", "Friday", "Saturday",
+};
+const char* const kMonthShort[12] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec",
+};
+const char* const kMonthFull[12] = {
+    "January", "February", "March",     "April",   "May",      "June",
+    "July",    "August",   "September", "October", "November", "December",
+};
+
+// The number of ISO 8601 weeks in the given week-based year.
+int WeeksInIsoYear(year_t year) {
+  const weekday jan1 = get_weekday(civil_day(year, 1, 1));
+  if (jan1 == weekday::thursday) return 53;
+  const bool leap_year =
+      (year % 4) == 0 && ((year % 100) != 0 || (year % 400) == 0);
+  if (leap_year && jan1 == weekday::wednesday) return 53;
+  return 52;
+}
+
+// Computes the ISO 8601 week-based year and week number for %G/%g/%V.
+void IsoWeek(const civil_second& cs, int tm_wday, year_t* iso_year,
+             int* iso_week) {
+  const int iso_wday = (tm_wday == 0) ? 7 : tm_wday;  // Mon=1 ... Sun=7
+  int week = (get_yearday(cs) - iso_wday + 10) / 7;
+  year_t year = cs.year();
+  if (week < 1) {
+    year -= 1;
+    week = WeeksInIsoYear(year);
+  } else if (week > WeeksInIsoYear(year)) {
+    year += 1;
+    week = 1;
+  }
+  *iso_year = year;
+  *iso_week = week;
+}
+
 // Formats a 64-bit integer in the given field width.  Note that it is up
 // to the caller of Format64() [and Format02d()/FormatOffset()] to ensure
 // that there is sufficient space before ep to hold the conversion.
@@ -131,19 +205,57 @@ char* Format64(char* ep, int width, std::int_fast64_t v) {
     }
     v = -v;
   }
-  do {
+  while (v >= 100) {  // a table lookup emits two digits at a time
+    const char* src = kTwoDigits + (v % 100) * 2;
+    v /= 100;
+    width -= 2;
+    *--ep = src[1];
+    *--ep = src[0];
+  }
+  if (v >= 10) {
+    const char* src = kTwoDigits + v * 2;
+    width -= 2;
+    *--ep = src[1];
+    *--ep = src[0];
+  } else {
     --width;
-    *--ep = kDigits[v % 10];
-  } while (v /= 10);
+    *--ep = kDigits[v];
+  }
   while (--width >= 0) *--ep = '0';  // zero pad
   if (neg) *--ep = '-';
   return ep;
 }
 
-// Formats [0 .. 99] as %02d.
+// Formats [0 .. 99] as %02d with a single table lookup.
 char* Format02d(char* ep, int v) {
-  *--ep = kDigits[v % 10];
-  *--ep = kDigits[(v / 10) % 10];
+  const char* src = kTwoDigits + v * 2;
+  *--ep = src[1];
+  *--ep = src[0];
+  return ep;
+}
+
+// Formats a civil_second as "YYYY-MM-DD HH:MM:SS" in one shot, using
+// the three separator characters in "seps" (within the date, between
+// date and time, and within the time). The common four-digit year is
+// emitted as two digit pairs; other years take the Format64() path.
+char* FormatCivil(char* ep, const civil_second& cs, const char* seps) {
+  ep = Format02d(ep, cs.second());
+  *--ep = seps[2];
+  ep = Format02d(ep, cs.minute());
+  *--ep = seps[2];
+  ep = Format02d(ep, cs.hour());
+  *--ep = seps[1];
+  ep = Format02d(ep, cs.day());
+  *--ep = seps[0];
+  ep = Format02d(ep, cs.month());
+  *--ep = seps[0];
+  if (cs.year() >= 0 && cs.year() <= 9999) {
+    const int year = static_cast<int>(cs.year());
+    ep = Format02d(ep, year % 100);
+    ep = Format02d(ep, year / 100);
+  } else {
+    ep = Format64(ep, 0, cs.year());
+  }
   return ep;
 }
 
@@ -187,6 +299,7 @@ void FormatTM(std::string* out, char_range fmt_range, const std::tm& tm) {
   // an error, like the array wasn't large enough.  To accommodate this,
   // the following code grows the buffer size from 2x the format string
   // length up to 32x.
+  CCTZ_STATS_COUNT(format_strftime_fallback_count);
   std::string fmt(fmt_range.begin, fmt_range.end);
   for (std::size_t i = 2; i != 32; i *= 2) {
     std::size_t buf_size = fmt.size() * i;
@@ -271,9 +384,12 @@ const std::int_fast64_t kExp10[kDigits10_64 + 1] = {
 //   - %E*S - Seconds with full fractional precision (a literal '*')
 //   - %E4Y - Four-character years (-999 ... -001, 0000, 0001 ... 9999)
 //
-// The standard specifiers from RFC3339_* (%Y, %m, %d, %H, %M, and %S) are
-// handled internally for performance reasons.  strftime(3) is slow due to
-// a POSIX requirement to respect changes to ${TZ}.
+// The standard specifiers are all handled internally, using a fixed C
+// locale, so no format string ever reaches strftime(3).  strftime(3) is
+// slow due to a POSIX requirement to respect changes to ${TZ}, and it
+// re-examines the process locale on every call.  It remains only as the
+// fallback for non-standard specifier sequences, whose expansion is
+// implementation-defined.
 //
 // The TZ/GNU %s extension is handled internally because strftime() has
 // to use mktime() to generate it, and that assumes the local time zone.
@@ -284,13 +400,14 @@ const std::int_fast64_t kExp10[kDigits10_64 + 1] = {
 // Requires that zero() <= fs < seconds(1).
 std::string format(char_range format, const time_point<seconds>& tp,
                    const detail::femtoseconds& fs, const time_zone& tz) {
+  CCTZ_STATS_COUNT(format_call_count);
   std::string result;
   result.reserve(format.size());  // A reasonable guess for the result size.
   const time_zone::absolute_lookup al = tz.lookup(tp);
   const std::tm tm = ToTM(al);
 
   // Scratch buffer for internal conversions.
-  char buf[3 + kDigits10_64];  // enough for longest conversion
+  char buf[14 + kDigits10_64];  // enough for longest conversion (%F)
   char* const ep = buf + sizeof(buf);
   char* bp;  // works back from ep
 
@@ -333,8 +450,8 @@ std::string format(char_range format, const time_point<seconds>& tp,
     // Loop unless we have an unescaped percent.
     if (cur == end || (cur - percent) % 2 == 0) continue;
 
-    // Simple specifiers that we handle ourselves.
-    if (strchr("YmdeHMSzZs%", *cur)) {
+    // Specifiers that we handle ourselves.
+    if (strchr("YmdeHMSzZs%aAbBhcCDFgGIjklnprRtTuUVwWxXy", *cur)) {
       if (cur - 1 != pending) {
         FormatTM(&result, char_range(pending, cur - 1), tm);
       }
@@ -378,6 +495,166 @@ std::string format(char_range format, const time_point<seconds>& tp,
           bp = Format64(ep, 0, ToUnixSeconds(tp));
           result.append(bp, static_cast<std::size_t>(ep - bp));
           break;
+        case 'a':
+          result.append(kWeekdayShort[tm.tm_wday]);
+          break;
+        case 'A':
+          result.append(kWeekdayFull[tm.tm_wday]);
+          break;
+        case 'b':
+        case 'h':
+          result.append(kMonthShort[al.cs.month() - 1]);
+          break;
+        case 'B':
+          result.append(kMonthFull[al.cs.month() - 1]);
+          break;
+        case 'c':  // synonym for "%a %b %e %H:%M:%S %Y"
+          result.append(kWeekdayShort[tm.tm_wday]);
+          result.push_back(' ');
+          result.append(kMonthShort[al.cs.month() - 1]);
+          result.push_back(' ');
+          bp = Format02d(ep, al.cs.day());
+          if (*bp == '0') *bp = ' ';
+          result.append(bp, static_cast<std::size_t>(ep - bp));
+          result.push_back(' ');
+          bp = Format02d(ep, al.cs.second());
+          *--bp = ':';
+          bp = Format02d(bp, al.cs.minute());
+          *--bp = ':';
+          bp = Format02d(bp, al.cs.hour());
+          result.append(bp, static_cast<std::size_t>(ep - bp));
+          result.push_back(' ');
+          bp = Format64(ep, 0, al.cs.year());
+          result.append(bp, static_cast<std::size_t>(ep - bp));
+          break;
+        case 'C': {
+          year_t century = al.cs.year() / 100;
+          if (al.cs.year() % 100 < 0) century -= 1;  // floor
+          bp = Format64(ep, 2, century);
+          result.append(bp, static_cast<std::size_t>(ep - bp));
+          break;
+        }
+        case 'D':  // synonym for %m/%d/%y
+        case 'x': {
+          int yy = static_cast<int>(al.cs.year() % 100);
+          if (yy < 0) yy = -yy;
+          bp = Format02d(ep, yy);
+          *--bp = '/';
+          bp = Format02d(bp, al.cs.day());
+          *--bp = '/';
+          bp = Format02d(bp, al.cs.month());
+          result.append(bp, static_cast<std::size_t>(ep - bp));
+          break;
+        }
+        case 'F':  // synonym for %Y-%m-%d
+          bp = Format02d(ep, al.cs.day());
+          *--bp = '-';
+          bp = Format02d(bp, al.cs.month());
+          *--bp = '-';
+          bp = Format64(bp, 0, al.cs.year());
+          result.append(bp, static_cast<std::size_t>(ep - bp));
+          break;
+        case 'g': {
+          year_t iso_year;
+          int iso_week;
+          IsoWeek(al.cs, tm.tm_wday, &iso_year, &iso_week);
+          int yy = static_cast<int>(iso_year % 100);
+          if (yy < 0) yy = -yy;
+          bp = Format02d(ep, yy);
+          result.append(bp, static_cast<std::size_t>(ep - bp));
+          break;
+        }
+        case 'G': {
+          year_t iso_year;
+          int iso_week;
+          IsoWeek(al.cs, tm.tm_wday, &iso_year, &iso_week);
+          bp = Format64(ep, 0, iso_year);
+          result.append(bp, static_cast<std::size_t>(ep - bp));
+          break;
+        }
+        case 'I':
+        case 'l': {
+          const int hour12 = (al.cs.hour() % 12 == 0) ? 12 : al.cs.hour() % 12;
+          bp = Format02d(ep, hour12);
+          if (*cur == 'l' && *bp == '0') *bp = ' ';
+          result.append(bp, static_cast<std::size_t>(ep - bp));
+          break;
+        }
+        case 'j':
+          bp = Format64(ep, 3, get_yearday(al.cs));
+          result.append(bp, static_cast<std::size_t>(ep - bp));
+          break;
+        case 'k':
+          bp = Format02d(ep, al.cs.hour());
+          if (*bp == '0') *bp = ' ';
+          result.append(bp, static_cast<std::size_t>(ep - bp));
+          break;
+        case 'n':
+          result.push_back('\n');
+          break;
+        case 'p':
+          result.append(al.cs.hour() < 12 ? "AM" : "PM");
+          break;
+        case 'r': {  // synonym for "%I:%M:%S %p"
+          const int hour12 = (al.cs.hour() % 12 == 0) ? 12 : al.cs.hour() % 12;
+          bp = Format02d(ep, al.cs.second());
+          *--bp = ':';
+          bp = Format02d(bp, al.cs.minute());
+          *--bp = ':';
+          bp = Format02d(bp, hour12);
+          result.append(bp, static_cast<std::size_t>(ep - bp));
+          result.push_back(' ');
+          result.append(al.cs.hour() < 12 ? "AM" : "PM");
+          break;
+        }
+        case 'R':  // synonym for %H:%M
+          bp = Format02d(ep, al.cs.minute());
+          *--bp = ':';
+          bp = Format02d(bp, al.cs.hour());
+          result.append(bp, static_cast<std::size_t>(ep - bp));
+          break;
+        case 't':
+          result.push_back('\t');
+          break;
+        case 'T':  // synonym for %H:%M:%S
+        case 'X':
+          bp = Format02d(ep, al.cs.second());
+          *--bp = ':';
+          bp = Format02d(bp, al.cs.minute());
+          *--bp = ':';
+          bp = Format02d(bp, al.cs.hour());
+          result.append(bp, static_cast<std::size_t>(ep - bp));
+          break;
+        case 'u':
+          result.push_back(
+              kDigits[(tm.tm_wday == 0) ? 7 : tm.tm_wday]);  // Mon=1
+          break;
+        case 'U':
+          bp = Format02d(ep, (tm.tm_yday + 7 - tm.tm_wday) / 7);
+          result.append(bp, static_cast<std::size_t>(ep - bp));
+          break;
+        case 'V': {
+          year_t iso_year;
+          int iso_week;
+          IsoWeek(al.cs, tm.tm_wday, &iso_year, &iso_week);
+          bp = Format02d(ep, iso_week);
+          result.append(bp, static_cast<std::size_t>(ep - bp));
+          break;
+        }
+        case 'w':
+          result.push_back(kDigits[tm.tm_wday]);
+          break;
+        case 'W':
+          bp = Format02d(ep, (tm.tm_yday + 7 - (tm.tm_wday + 6) % 7) / 7);
+          result.append(bp, static_cast<std::size_t>(ep - bp));
+          break;
+        case 'y': {
+          int yy = static_cast<int>(al.cs.year() % 100);
+          if (yy < 0) yy = -yy;
+          bp = Format02d(ep, yy);
+          result.append(bp, static_cast<std::size_t>(ep - bp));
+          break;
+        }
         case '%':
           result.push_back('%');
           break;
@@ -508,6 +785,686 @@ std::string format(char_range format, const time_point<seconds>& tp,
   return result;
 }
 
+// A format specification compiled by compile_format() into a sequence
+// of literal copies and field conversions, so that the scanning and
+// dispatch work in format() is not repeated when the same specification
+// is used to format many time points.
+struct format_plan {
+  enum Op : char {
+    kLiteral,      // literal text (including %%, %n, and %t expansions)
+    kYear,         // %Y
+    kYear2,        // %y
+    kYear4,        // %E4Y
+    kCentury,      // %C
+    kMonth,        // %m
+    kMonthShort,   // %b %h
+    kMonthFull,    // %B
+    kDay,          // %d
+    kDayBlank,     // %e
+    kHour,         // %H
+    kHourBlank,    // %k
+    kHour12,       // %I
+    kHour12Blank,  // %l
+    kMinute,       // %M
+    kSecond,       // %S
+    kAmPm,         // %p
+    kWeekdayShort, // %a
+    kWeekdayFull,  // %A
+    kWeekdayIso,   // %u
+    kWeekdayNum,   // %w
+    kYearday,      // %j
+    kWeekSunday,   // %U
+    kWeekMonday,   // %W
+    kIsoWeek,      // %V
+    kIsoYear,      // %G
+    kIsoYear2,     // %g
+    kCivil,        // a fused %Y?%m?%d?%H?%M?%S run; text holds the
+                   // three separator characters (see compile_format())
+    kDateMDY,      // %D %x
+    kDateYMD,      // %F
+    kTimeHM,       // %R
+    kTimeHMS,      // %T %X
+    kTime12,       // %r
+    kCTime,        // %c
+    kOffset,       // %z %Ez %E*z %:z %::z %:::z; text holds the mode
+    kAbbr,         // %Z
+    kUnix,         // %s
+    kSubsecondS,   // %E#S/%E*S; arg is # digits, or -1 for '*'
+    kSubsecondF,   // %E#f/%E*f; arg is # digits, or -1 for '*'
+  };
+  struct step {
+    Op op;
+    int arg;           // subsecond digit count
+    std::string text;  // kLiteral text or kOffset mode
+  };
+  std::vector<step> steps;
+  bool ok = false;          // every conversion was compiled
+  bool needs_wday = false;  // some step uses the weekday
+  std::string fallback;     // the original specification, for when !ok
+};
+
+namespace {
+
+// An output target for compiled formatting: either a growable string
+// or a fixed-size caller-provided buffer.
+struct FormatSink {
+  explicit FormatSink(std::string* s) : str(s) {}
+  FormatSink(char* p, std::size_t n) : buf(p), buf_end(p + n) {}
+  void Append(const char* p, std::size_t n) {
+    if (str != nullptr) {
+      str->append(p, n);
+    } else if (n <= static_cast<std::size_t>(buf_end - buf)) {
+      memcpy(buf, p, n);
+      buf += n;
+    } else {
+      overflow = true;
+    }
+  }
+  void Append(const char* p) { Append(p, strlen(p)); }
+  void Append(const std::string& s) { Append(s.data(), s.size()); }
+  void Push(char c) { Append(&c, 1); }
+  std::string* str = nullptr;
+  char* buf = nullptr;
+  char* buf_end = nullptr;
+  bool overflow = false;
+};
+
+// Renders a %E#S/%E*S/%E#f/%E*f conversion for the given seconds field
+// and subseconds.  Shared by FormatStepsTo() and the second-granularity
+// cache behind cctz::cached_formatter.
+void FormatSubsecond(FormatSink* sink, format_plan::Op op, int arg,
+                     int second, const detail::femtoseconds& fs) {
+  char buf[4 + kDigits10_64];
+  char* const ep = buf + sizeof(buf);
+  char* bp;
+  if (arg < 0) {  // full precision
+    char* cp = ep;
+    bp = Format64(cp, 15, fs.count());
+    while (cp != bp && cp[-1] == '0') --cp;
+    if (op == format_plan::kSubsecondS) {
+      if (cp != bp) *--bp = '.';
+      bp = Format02d(bp, second);
+    } else {
+      if (cp == bp) *--bp = '0';
+    }
+    sink->Append(bp, static_cast<std::size_t>(cp - bp));
+  } else {
+    const int n = arg;  // already clamped to kDigits10_64
+    bp = ep;
+    if (n > 0) {
+      bp = Format64(bp, n,
+                    (n > 15) ? fs.count() * kExp10[n - 15]
+                             : fs.count() / kExp10[15 - n]);
+      if (op == format_plan::kSubsecondS) *--bp = '.';
+    }
+    if (op == format_plan::kSubsecondS) {
+      bp = Format02d(bp, second);
+    }
+    sink->Append(bp, static_cast<std::size_t>(ep - bp));
+  }
+}
+
+// Replays a range of compiled steps for the given time point.  Each
+// step is a straight-line conversion using the same emitters as
+// format(), so the output is identical to formatting with the original
+// specification.
+void FormatStepsTo(FormatSink* sink, const format_plan::step* sp,
+                   const format_plan::step* se, bool needs_wday,
+                   const time_point<seconds>& tp,
+                   const detail::femtoseconds& fs, const time_zone& tz) {
+  const time_zone::absolute_lookup al = tz.lookup(tp);
+  const int tm_wday = needs_wday ? ToTmWday(get_weekday(al.cs)) : 0;
+
+  // Scratch buffer for internal conversions.
+  char buf[20 + kDigits10_64];  // enough for longest conversion (kCivil)
+  char* const ep = buf + sizeof(buf);
+  char* bp;  // works back from ep
+
+  for (; sp != se; ++sp) {
+    const format_plan::step& step = *sp;
+    switch (step.op) {
+      case format_plan::kLiteral:
+        sink->Append(step.text);
+        break;
+      case format_plan::kYear:
+        bp = Format64(ep, 0, al.cs.year());
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      case format_plan::kYear2: {
+        int yy = static_cast<int>(al.cs.year() % 100);
+        if (yy < 0) yy = -yy;
+        bp = Format02d(ep, yy);
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      }
+      case format_plan::kYear4:
+        bp = Format64(ep, 4, al.cs.year());
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      case format_plan::kCentury: {
+        year_t century = al.cs.year() / 100;
+        if (al.cs.year() % 100 < 0) century -= 1;  // floor
+        bp = Format64(ep, 2, century);
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      }
+      case format_plan::kMonth:
+        bp = Format02d(ep, al.cs.month());
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      case format_plan::kMonthShort:
+        sink->Append(kMonthShort[al.cs.month() - 1]);
+        break;
+      case format_plan::kMonthFull:
+        sink->Append(kMonthFull[al.cs.month() - 1]);
+        break;
+      case format_plan::kDay:
+      case format_plan::kDayBlank:
+        bp = Format02d(ep, al.cs.day());
+        if (step.op == format_plan::kDayBlank && *bp == '0') *bp = ' ';
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      case format_plan::kHour:
+      case format_plan::kHourBlank:
+        bp = Format02d(ep, al.cs.hour());
+        if (step.op == format_plan::kHourBlank && *bp == '0') *bp = ' ';
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      case format_plan::kHour12:
+      case format_plan::kHour12Blank: {
+        const int hour12 = (al.cs.hour() % 12 == 0) ? 12 : al.cs.hour() % 12;
+        bp = Format02d(ep, hour12);
+        if (step.op == format_plan::kHour12Blank && *bp == '0') *bp = ' ';
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      }
+      case format_plan::kMinute:
+        bp = Format02d(ep, al.cs.minute());
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      case format_plan::kSecond:
+        bp = Format02d(ep, al.cs.second());
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      case format_plan::kAmPm:
+        sink->Append(al.cs.hour() < 12 ? "AM" : "PM");
+        break;
+      case format_plan::kWeekdayShort:
+        sink->Append(kWeekdayShort[tm_wday]);
+        break;
+      case format_plan::kWeekdayFull:
+        sink->Append(kWeekdayFull[tm_wday]);
+        break;
+      case format_plan::kWeekdayIso:
+        sink->Push(kDigits[(tm_wday == 0) ? 7 : tm_wday]);  // Mon=1
+        break;
+      case format_plan::kWeekdayNum:
+        sink->Push(kDigits[tm_wday]);
+        break;
+      case format_plan::kYearday:
+        bp = Format64(ep, 3, get_yearday(al.cs));
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      case format_plan::kWeekSunday: {
+        const int tm_yday = get_yearday(al.cs) - 1;
+        bp = Format02d(ep, (tm_yday + 7 - tm_wday) / 7);
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      }
+      case format_plan::kWeekMonday: {
+        const int tm_yday = get_yearday(al.cs) - 1;
+        bp = Format02d(ep, (tm_yday + 7 - (tm_wday + 6) % 7) / 7);
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      }
+      case format_plan::kIsoWeek: {
+        year_t iso_year;
+        int iso_week;
+        IsoWeek(al.cs, tm_wday, &iso_year, &iso_week);
+        bp = Format02d(ep, iso_week);
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      }
+      case format_plan::kIsoYear: {
+        year_t iso_year;
+        int iso_week;
+        IsoWeek(al.cs, tm_wday, &iso_year, &iso_week);
+        bp = Format64(ep, 0, iso_year);
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      }
+      case format_plan::kIsoYear2: {
+        year_t iso_year;
+        int iso_week;
+        IsoWeek(al.cs, tm_wday, &iso_year, &iso_week);
+        int yy = static_cast<int>(iso_year % 100);
+        if (yy < 0) yy = -yy;
+        bp = Format02d(ep, yy);
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      }
+      case format_plan::kCivil:
+        bp = FormatCivil(ep, al.cs, step.text.data());
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      case format_plan::kDateMDY: {
+        int yy = static_cast<int>(al.cs.year() % 100);
+        if (yy < 0) yy = -yy;
+        bp = Format02d(ep, yy);
+        *--bp = '/';
+        bp = Format02d(bp, al.cs.day());
+        *--bp = '/';
+        bp = Format02d(bp, al.cs.month());
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      }
+      case format_plan::kDateYMD:
+        bp = Format02d(ep, al.cs.day());
+        *--bp = '-';
+        bp = Format02d(bp, al.cs.month());
+        *--bp = '-';
+        bp = Format64(bp, 0, al.cs.year());
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      case format_plan::kTimeHM:
+        bp = Format02d(ep, al.cs.minute());
+        *--bp = ':';
+        bp = Format02d(bp, al.cs.hour());
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      case format_plan::kTimeHMS:
+        bp = Format02d(ep, al.cs.second());
+        *--bp = ':';
+        bp = Format02d(bp, al.cs.minute());
+        *--bp = ':';
+        bp = Format02d(bp, al.cs.hour());
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      case format_plan::kTime12: {
+        const int hour12 = (al.cs.hour() % 12 == 0) ? 12 : al.cs.hour() % 12;
+        bp = Format02d(ep, al.cs.second());
+        *--bp = ':';
+        bp = Format02d(bp, al.cs.minute());
+        *--bp = ':';
+        bp = Format02d(bp, hour12);
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        sink->Push(' ');
+        sink->Append(al.cs.hour() < 12 ? "AM" : "PM");
+        break;
+      }
+      case format_plan::kCTime:  // "%a %b %e %H:%M:%S %Y"
+        sink->Append(kWeekdayShort[tm_wday]);
+        sink->Push(' ');
+        sink->Append(kMonthShort[al.cs.month() - 1]);
+        sink->Push(' ');
+        bp = Format02d(ep, al.cs.day());
+        if (*bp == '0') *bp = ' ';
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        sink->Push(' ');
+        bp = Format02d(ep, al.cs.second());
+        *--bp = ':';
+        bp = Format02d(bp, al.cs.minute());
+        *--bp = ':';
+        bp = Format02d(bp, al.cs.hour());
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        sink->Push(' ');
+        bp = Format64(ep, 0, al.cs.year());
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      case format_plan::kOffset:
+        bp = FormatOffset(ep, al.offset, step.text.c_str());
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      case format_plan::kAbbr:
+        sink->Append(al.abbr);
+        break;
+      case format_plan::kUnix:
+        bp = Format64(ep, 0, ToUnixSeconds(tp));
+        sink->Append(bp, static_cast<std::size_t>(ep - bp));
+        break;
+      case format_plan::kSubsecondS:
+      case format_plan::kSubsecondF:
+        FormatSubsecond(sink, step.op, step.arg, al.cs.second(), fs);
+        break;
+    }
+  }
+}
+
+// Replays a whole compiled plan.
+void FormatPlanTo(FormatSink* sink, const format_plan& plan,
+                  const time_point<seconds>& tp,
+                  const detail::femtoseconds& fs, const time_zone& tz) {
+  const format_plan::step* const sp = plan.steps.data();
+  FormatStepsTo(sink, sp, sp + plan.steps.size(), plan.needs_wday, tp, fs, tz);
+}
+
+}  // namespace
+
+// Compiles a format() specification into a format_plan.  Standard and
+// extended conversions all compile; if the specification contains a
+// non-standard sequence (whose strftime(3) expansion we cannot predict)
+// the plan is marked !ok and retains the original specification so that
+// format(plan, ...) can fall back to the uncompiled path.
+std::shared_ptr<const format_plan> compile_format(char_range fmt) {
+  auto plan = std::make_shared<format_plan>();
+  plan->fallback.assign(fmt.begin, fmt.end);
+
+  std::string literal;
+  auto flush_literal = [&plan, &literal]() {
+    if (!literal.empty()) {
+      plan->steps.push_back(format_plan::step{format_plan::kLiteral, 0, literal});
+      literal.clear();
+    }
+  };
+
+  const char* cur = fmt.begin;
+  const char* end = fmt.end;
+  bool ok = true;
+  while (ok && cur != end) {
+    if (*cur != '%') {
+      literal.push_back(*cur++);
+      continue;
+    }
+    if (++cur == end) {  // a trailing '%' is copied out literally
+      literal.push_back('%');
+      break;
+    }
+    format_plan::Op op = format_plan::kLiteral;
+    int arg = 0;
+    const char* mode = "";
+    switch (*cur) {
+      case '%':
+        literal.push_back('%');
+        ++cur;
+        continue;
+      case 'n':
+        literal.push_back('\n');
+        ++cur;
+        continue;
+      case 't':
+        literal.push_back('\t');
+        ++cur;
+        continue;
+      case 'Y': op = format_plan::kYear; break;
+      case 'y': op = format_plan::kYear2; break;
+      case 'C': op = format_plan::kCentury; break;
+      case 'm': op = format_plan::kMonth; break;
+      case 'b':
+      case 'h': op = format_plan::kMonthShort; break;
+      case 'B': op = format_plan::kMonthFull; break;
+      case 'd': op = format_plan::kDay; break;
+      case 'e': op = format_plan::kDayBlank; break;
+      case 'H': op = format_plan::kHour; break;
+      case 'k': op = format_plan::kHourBlank; break;
+      case 'I': op = format_plan::kHour12; break;
+      case 'l': op = format_plan::kHour12Blank; break;
+      case 'M': op = format_plan::kMinute; break;
+      case 'S': op = format_plan::kSecond; break;
+      case 'p': op = format_plan::kAmPm; break;
+      case 'a': op = format_plan::kWeekdayShort; break;
+      case 'A': op = format_plan::kWeekdayFull; break;
+      case 'u': op = format_plan::kWeekdayIso; break;
+      case 'w': op = format_plan::kWeekdayNum; break;
+      case 'j': op = format_plan::kYearday; break;
+      case 'U': op = format_plan::kWeekSunday; break;
+      case 'W': op = format_plan::kWeekMonday; break;
+      case 'V': op = format_plan::kIsoWeek; break;
+      case 'G': op = format_plan::kIsoYear; break;
+      case 'g': op = format_plan::kIsoYear2; break;
+      case 'D':
+      case 'x': op = format_plan::kDateMDY; break;
+      case 'F': op = format_plan::kDateYMD; break;
+      case 'R': op = format_plan::kTimeHM; break;
+      case 'T':
+      case 'X': op = format_plan::kTimeHMS; break;
+      case 'r': op = format_plan::kTime12; break;
+      case 'c': op = format_plan::kCTime; break;
+      case 'z': op = format_plan::kOffset; break;
+      case 'Z': op = format_plan::kAbbr; break;
+      case 's': op = format_plan::kUnix; break;
+      case ':':  // %:z, %::z, or %:::z
+        op = format_plan::kOffset;
+        if (end - cur >= 2 && cur[1] == 'z') {
+          mode = ":";
+          cur += 1;
+        } else if (end - cur >= 3 && cur[1] == ':' && cur[2] == 'z') {
+          mode = ":*";
+          cur += 2;
+        } else if (end - cur >= 4 && cur[1] == ':' && cur[2] == ':' &&
+                   cur[3] == 'z') {
+          mode = ":*:";
+          cur += 3;
+        } else {
+          ok = false;
+        }
+        break;
+      case 'E':
+        if (end - cur >= 2 && cur[1] == 'z') {
+          op = format_plan::kOffset;
+          mode = ":";
+          cur += 1;
+        } else if (end - cur >= 3 && cur[1] == '*' && cur[2] == 'z') {
+          op = format_plan::kOffset;
+          mode = ":*";
+          cur += 2;
+        } else if (end - cur >= 3 && cur[1] == '*' && cur[2] == 'S') {
+          op = format_plan::kSubsecondS;
+          arg = -1;
+          cur += 2;
+        } else if (end - cur >= 3 && cur[1] == '*' && cur[2] == 'f') {
+          op = format_plan::kSubsecondF;
+          arg = -1;
+          cur += 2;
+        } else if (end - cur >= 3 && cur[1] == '4' && cur[2] == 'Y') {
+          op = format_plan::kYear4;
+          cur += 2;
+        } else if (end - cur >= 2 && std::isdigit(cur[1])) {
+          int n = 0;
+          const char* np = ParseInt(char_range(cur + 1, end), 0, 0, 1024, &n);
+          if (np != nullptr && np != end && (*np == 'S' || *np == 'f')) {
+            op = (*np == 'S') ? format_plan::kSubsecondS
+                              : format_plan::kSubsecondF;
+            arg = (n > kDigits10_64) ? kDigits10_64 : n;
+            cur = np;
+          } else {
+            ok = false;
+          }
+        } else {
+          ok = false;
+        }
+        break;
+      default:
+        ok = false;
+        break;
+    }
+    if (!ok) break;
+    flush_literal();
+    plan->steps.push_back(format_plan::step{op, arg, std::string(mode)});
+    ++cur;
+  }
+  if (ok) {
+    flush_literal();
+    plan->ok = true;
+
+    // Fuses "%Y?%m?%d?%H?%M?%S"-shaped runs with single-character
+    // separators (e.g., the ubiquitous "%Y-%m-%d %H:%M:%S") into one
+    // kCivil step, so the whole timestamp renders in a single fused
+    // conversion (see FormatCivil()).
+    auto is_sep = [](const format_plan::step& step) {
+      return step.op == format_plan::kLiteral && step.text.size() == 1;
+    };
+    if (plan->steps.size() >= 11) {
+      std::vector<format_plan::step> fused;
+      fused.reserve(plan->steps.size());
+      std::size_t i = 0;
+      while (i != plan->steps.size()) {
+        const format_plan::step* const s = &plan->steps[i];
+        if (plan->steps.size() - i >= 11 &&
+            s[0].op == format_plan::kYear && is_sep(s[1]) &&
+            s[2].op == format_plan::kMonth && s[3].op == format_plan::kLiteral &&
+            s[3].text == s[1].text && s[4].op == format_plan::kDay &&
+            is_sep(s[5]) && s[6].op == format_plan::kHour && is_sep(s[7]) &&
+            s[8].op == format_plan::kMinute &&
+            s[9].op == format_plan::kLiteral && s[9].text == s[7].text &&
+            s[10].op == format_plan::kSecond) {
+          std::string seps;
+          seps.push_back(s[1].text[0]);
+          seps.push_back(s[5].text[0]);
+          seps.push_back(s[7].text[0]);
+          fused.push_back(format_plan::step{format_plan::kCivil, 0, seps});
+          i += 11;
+        } else {
+          fused.push_back(plan->steps[i]);
+          ++i;
+        }
+      }
+      plan->steps = std::move(fused);
+    }
+
+    for (const format_plan::step& step : plan->steps) {
+      switch (step.op) {
+        case format_plan::kWeekdayShort:
+        case format_plan::kWeekdayFull:
+        case format_plan::kWeekdayIso:
+        case format_plan::kWeekdayNum:
+        case format_plan::kWeekSunday:
+        case format_plan::kWeekMonday:
+        case format_plan::kIsoWeek:
+        case format_plan::kIsoYear:
+        case format_plan::kIsoYear2:
+        case format_plan::kCTime:
+          plan->needs_wday = true;
+          break;
+        default:
+          break;
+      }
+    }
+  } else {
+    plan->steps.clear();  // format(plan, ...) will use the fallback
+  }
+  return plan;
+}
+
+bool format_plan_ok(const format_plan& plan) { return plan.ok; }
+
+// Formats the given time point by replaying a compiled plan.  Produces
+// output identical to format() with the plan's original specification.
+//
+// Requires that zero() <= fs < seconds(1).
+std::string format(const format_plan& plan, const time_point<seconds>& tp,
+                   const detail::femtoseconds& fs, const time_zone& tz) {
+  if (!plan.ok) return format(plan.fallback, tp, fs, tz);
+  CCTZ_STATS_COUNT(format_call_count);
+  std::string result;
+  result.reserve(plan.fallback.size());  // reasonable guess for result size
+  FormatSink sink(&result);
+  FormatPlanTo(&sink, plan, tp, fs, tz);
+  return result;
+}
+
+// Formats the given time point by replaying a compiled plan directly
+// into the caller-provided buffer, with no heap allocation.  The output
+// is NUL-terminated.  Returns the number of characters written (not
+// counting the NUL), or 0 if the buffer is too small.  An uncompiled
+// plan falls back to the allocating path and copies the result.
+//
+// Requires that zero() <= fs < seconds(1).
+std::size_t format_to(const format_plan& plan, const time_point<seconds>& tp,
+                      const detail::femtoseconds& fs, const time_zone& tz,
+                      char* buf, std::size_t size) {
+  if (size == 0) return 0;
+  if (!plan.ok) {
+    const std::string result = format(plan.fallback, tp, fs, tz);
+    if (result.size() >= size) return 0;
+    memcpy(buf, result.c_str(), result.size() + 1);
+    return result.size();
+  }
+  FormatSink sink(buf, size - 1);  // reserve room for the NUL
+  FormatPlanTo(&sink, plan, tp, fs, tz);
+  if (sink.overflow) return 0;
+  *sink.buf = '\0';
+  return static_cast<std::size_t>(sink.buf - buf);
+}
+
+// The state behind a cctz::cached_formatter: a compiled plan, split at
+// its subsecond conversion (if any), plus the text rendered for the
+// most recently formatted second.  While the formatted second (and the
+// zone) is unchanged the cached text is reused and only the subsecond
+// conversion is re-rendered, which honors DST boundaries for free since
+// any offset change implies a new formatted second.
+struct cached_format {
+  std::shared_ptr<const format_plan> plan;
+  std::size_t subsec_step;     // step index, or steps.size() if none
+  format_plan::Op subsec_op;   // valid when subsec_step < steps.size()
+  int subsec_arg;              // likewise
+  bool cacheable;              // a compiled plan with <= 1 subsecond step
+
+  // The cache.
+  bool valid = false;
+  time_point<seconds> tp;      // the cached second
+  time_zone zone;              // the zone it was rendered in
+  int second;                  // its seconds field, for the subseconds
+  std::string prefix;          // rendered text before the subseconds
+  std::string suffix;          // rendered text after the subseconds
+};
+
+std::shared_ptr<cached_format> make_cached_format(char_range fmt) {
+  auto cf = std::make_shared<cached_format>();
+  cf->plan = compile_format(fmt);
+  cf->subsec_step = cf->plan->steps.size();
+  cf->subsec_op = format_plan::kLiteral;
+  cf->subsec_arg = 0;
+  std::size_t nsubsec = 0;
+  for (std::size_t i = 0; i != cf->plan->steps.size(); ++i) {
+    const format_plan::Op op = cf->plan->steps[i].op;
+    if (op == format_plan::kSubsecondS || op == format_plan::kSubsecondF) {
+      cf->subsec_step = i;
+      cf->subsec_op = op;
+      cf->subsec_arg = cf->plan->steps[i].arg;
+      ++nsubsec;
+    }
+  }
+  cf->cacheable = cf->plan->ok && nsubsec <= 1;
+  return cf;
+}
+
+// Formats the given time point through the second-granularity cache.
+// Produces output identical to format() with the original specification.
+std::string format(cached_format& cf, const time_point<seconds>& tp,
+                   const detail::femtoseconds& fs, const time_zone& tz) {
+  if (!cf.cacheable) return format(*cf.plan, tp, fs, tz);
+  CCTZ_STATS_COUNT(format_call_count);
+
+  const std::size_t nsteps = cf.plan->steps.size();
+  if (!cf.valid || tp != cf.tp || !(tz == cf.zone)) {
+    const format_plan::step* const sb = cf.plan->steps.data();
+    const format_plan::step* const ss = sb + cf.subsec_step;
+    cf.prefix.clear();
+    FormatSink prefix_sink(&cf.prefix);
+    FormatStepsTo(&prefix_sink, sb, ss, cf.plan->needs_wday, tp, fs, tz);
+    cf.suffix.clear();
+    if (cf.subsec_step != nsteps) {
+      FormatSink suffix_sink(&cf.suffix);
+      FormatStepsTo(&suffix_sink, ss + 1, sb + nsteps, cf.plan->needs_wday,
+                    tp, fs, tz);
+      cf.second = tz.lookup(tp).cs.second();
+    }
+    cf.tp = tp;
+    cf.zone = tz;
+    cf.valid = true;
+  }
+
+  std::string result;
+  result.reserve(cf.prefix.size() + cf.suffix.size() + 4 + kDigits10_64);
+  result = cf.prefix;
+  if (cf.subsec_step != nsteps) {
+    FormatSink sink(&result);
+    FormatSubsecond(&sink, cf.subsec_op, cf.subsec_arg, cf.second, fs);
+    result.append(cf.suffix);
+  }
+  return result;
+}
+
 namespace {
 
 const char* ParseOffset(char_range data, const char* mode, int* offset) {
@@ -598,6 +1555,7 @@ const char* ParseSubSeconds(char_range s, detail::femtoseconds* subseconds) {
 bool parse(char_range format, char_range input,
            const time_zone& tz, time_point<seconds>* sec,
            detail::femtoseconds* fs, std::string* err) {
+  CCTZ_STATS_COUNT(parse_call_count);
   auto make_err = [err]() {
     if (err != nullptr) *err = "Failed to parse input";
     return false;
@@ -802,6 +1760,7 @@ bool parse(char_range format, char_range input,
     const char* orig_input_pos = input.begin;
     std::string spec(percent, format.begin);
     null_terminated_scratch_buffer.assign(input.begin, input.size());
+    CCTZ_STATS_COUNT(parse_strptime_fallback_count);
     const char* tmp_p = strptime(null_terminated_scratch_buffer.c_str(), spec.c_str(), &tm);
     if (tmp_p == nullptr) return make_err();
     input.begin += tmp_p - null_terminated_scratch_buffer.data();
@@ -902,5 +1861,306 @@ bool parse(char_range format, char_range input,
   return true;
 }
 
+// A parse specification compiled by compile_parse() into a sequence of
+// literal matches and fixed-width field decodes, so that the scanning
+// and dispatch work in parse() is not repeated when the same
+// specification is used to parse many inputs.  Only specifications
+// built from literals and the fixed-width specifiers that parse()
+// handles internally compile; anything else sets !ok and
+// parse(plan, ...) falls back to the general parser.
+struct parse_plan {
+  enum Op : char {
+    kLiteral,      // literal text to match (including %% expansions)
+    kSpace,        // format whitespace: skips any input whitespace
+    kYear,         // %Y
+    kMonth,        // %m
+    kDay,          // %d %e
+    kHour,         // %H
+    kMinute,       // %M
+    kSecond,       // %S
+    kOffset,       // %z
+    kOffsetColon,  // %Ez %E*z
+  };
+  struct step {
+    Op op;
+    std::string text;  // kLiteral text
+  };
+  std::vector<step> steps;
+  bool ok = false;       // every conversion was compiled
+  std::string fallback;  // the original specification, for when !ok
+};
+
+namespace {
+
+// Decodes a one- or two-digit field, as with ParseInt() of width 2 over
+// the restricted ranges used below, but with a branch-free accumulation
+// of the common two-digit case.  Returns nullptr on failure.
+const char* ParseTwoDigits(char_range s, int min, int max, int* vp) {
+  if (s.begin == s.end) return nullptr;
+  const unsigned d0 = static_cast<unsigned char>(s.begin[0]) - '0';
+  if (d0 > 9) return nullptr;
+  int v = static_cast<int>(d0);
+  const char* cp = s.begin + 1;
+  if (cp != s.end) {
+    const unsigned d1 = static_cast<unsigned char>(*cp) - '0';
+    const bool two = d1 <= 9;
+    v = two ? v * 10 + static_cast<int>(d1) : v;
+    cp += two ? 1 : 0;
+  }
+  if (v < min || max < v) return nullptr;
+  *vp = v;
+  return cp;
+}
+
+// %Y, with a branch-free fast path for the common exactly-four-digit
+// year.  Falls back to ParseInt() for signed or oddly sized years.
+const char* ParseYear(char_range s, year_t* vp) {
+  if (s.end - s.begin >= 4) {
+    const unsigned d0 = static_cast<unsigned char>(s.begin[0]) - '0';
+    const unsigned d1 = static_cast<unsigned char>(s.begin[1]) - '0';
+    const unsigned d2 = static_cast<unsigned char>(s.begin[2]) - '0';
+    const unsigned d3 = static_cast<unsigned char>(s.begin[3]) - '0';
+    if ((d0 | d1 | d2 | d3) <= 9 &&
+        (s.end - s.begin == 4 ||
+         static_cast<unsigned>(static_cast<unsigned char>(s.begin[4]) - '0') >
+             9)) {
+      *vp = static_cast<year_t>(((d0 * 10 + d1) * 10 + d2) * 10 + d3);
+      return s.begin + 4;
+    }
+  }
+  return ParseInt(s, 0, std::numeric_limits<year_t>::min(),
+                  std::numeric_limits<year_t>::max(), vp);
+}
+
+// Replays a compiled plan over the input.  Semantically identical to
+// parse() with the plan's original specification: in particular,
+// unparsed fields keep the epoch defaults, and steps beyond the point
+// where the input is exhausted are simply skipped.
+bool ParsePlanned(const parse_plan& plan, char_range input,
+                  const time_zone& tz, time_point<seconds>* sec,
+                  detail::femtoseconds* fs) {
+  input.consume_leading_spaces();
+
+  // Unparsed fields keep the same defaults as in parse().
+  year_t year = 1970;
+  int month = 1;
+  int day = 1;
+  int hour = 0;
+  int minute = 0;
+  int second = 0;
+  bool saw_offset = false;
+  int offset = 0;  // No offset from passed tz.
+
+  for (const parse_plan::step& step : plan.steps) {
+    if (input.begin == input.end) break;
+    switch (step.op) {
+      case parse_plan::kLiteral: {
+        const char* p = step.text.data();
+        const char* const pe = p + step.text.size();
+        while (p != pe && input.begin != input.end) {
+          if (*input.begin != *p) return false;
+          ++input.begin;
+          ++p;
+        }
+        break;
+      }
+      case parse_plan::kSpace:
+        input.consume_leading_spaces();
+        break;
+      case parse_plan::kYear:
+        input.begin = ParseYear(input, &year);
+        if (input.begin == nullptr) return false;
+        break;
+      case parse_plan::kMonth:
+        input.begin = ParseTwoDigits(input, 1, 12, &month);
+        if (input.begin == nullptr) return false;
+        break;
+      case parse_plan::kDay:
+        input.begin = ParseTwoDigits(input, 1, 31, &day);
+        if (input.begin == nullptr) return false;
+        break;
+      case parse_plan::kHour:
+        input.begin = ParseTwoDigits(input, 0, 23, &hour);
+        if (input.begin == nullptr) return false;
+        break;
+      case parse_plan::kMinute:
+        input.begin = ParseTwoDigits(input, 0, 59, &minute);
+        if (input.begin == nullptr) return false;
+        break;
+      case parse_plan::kSecond:
+        input.begin = ParseTwoDigits(input, 0, 60, &second);
+        if (input.begin == nullptr) return false;
+        break;
+      case parse_plan::kOffset:
+        input.begin = ParseOffset(input, "", &offset);
+        if (input.begin == nullptr) return false;
+        saw_offset = true;
+        break;
+      case parse_plan::kOffsetColon:
+        input.begin = ParseOffset(input, ":", &offset);
+        if (input.begin == nullptr) return false;
+        saw_offset = true;
+        break;
+    }
+  }
+
+  input.consume_leading_spaces();
+  if (input.begin != input.end) return false;  // illegal trailing data
+
+  // The remainder mirrors the tail of parse().  With an explicit offset
+  // the fields are interpreted in UTC and then shifted; otherwise they
+  // are interpreted directly in the passed time zone.
+  const time_zone ptz = saw_offset ? utc_time_zone() : tz;
+
+  // Allows a leap second of 60 to normalize forward to the following ":00".
+  if (second == 60) {
+    second -= 1;
+    offset -= 1;
+  }
+
+  const civil_second cs(year, month, day, hour, minute, second);
+
+  // parse() does not allow normalization (e.g., "Sep 31" is an error,
+  // not "Oct 1"), and with the restricted field ranges above the only
+  // possibility is for days to roll into months.
+  if (cs.month() != month || cs.day() != day) return false;
+
+  // Accounts for the offset adjustment before converting to absolute time.
+  if ((offset < 0 && cs > civil_second::max() + offset) ||
+      (offset > 0 && cs < civil_second::min() + offset)) {
+    return false;
+  }
+  const civil_second ucs = cs - offset;
+
+  const auto tp = ptz.lookup(ucs).pre;
+  // Checks for overflow/underflow and returns an error as necessary.
+  if (tp == time_point<seconds>::max()) {
+    const auto al = ptz.lookup(time_point<seconds>::max());
+    if (ucs > al.cs) return false;
+  }
+  if (tp == time_point<seconds>::min()) {
+    const auto al = ptz.lookup(time_point<seconds>::min());
+    if (ucs < al.cs) return false;
+  }
+
+  *sec = tp;
+  *fs = detail::femtoseconds::zero();
+  return true;
+}
+
+}  // namespace
+
+std::shared_ptr<const parse_plan> compile_parse(char_range fmt) {
+  auto plan = std::make_shared<parse_plan>();
+  plan->fallback.assign(fmt.begin, fmt.end);
+
+  std::string literal;
+  auto flush_literal = [&plan, &literal]() {
+    if (!literal.empty()) {
+      plan->steps.push_back(parse_plan::step{parse_plan::kLiteral, literal});
+      literal.clear();
+    }
+  };
+
+  const char* cur = fmt.begin;
+  const char* end = fmt.end;
+  bool ok = true;
+  while (ok && cur != end) {
+    if (std::isspace(*cur)) {
+      flush_literal();
+      while (cur != end && std::isspace(*cur)) ++cur;
+      plan->steps.push_back(
+          parse_plan::step{parse_plan::kSpace, std::string()});
+      continue;
+    }
+    if (*cur != '%') {
+      literal.push_back(*cur++);
+      continue;
+    }
+    if (++cur == end) {  // a trailing '%' never matches
+      ok = false;
+      break;
+    }
+    parse_plan::Op op = parse_plan::kLiteral;
+    switch (*cur) {
+      case '%':
+        literal.push_back('%');
+        ++cur;
+        continue;
+      case 'Y': op = parse_plan::kYear; break;
+      case 'm': op = parse_plan::kMonth; break;
+      case 'd':
+      case 'e': op = parse_plan::kDay; break;
+      case 'H': op = parse_plan::kHour; break;
+      case 'M': op = parse_plan::kMinute; break;
+      case 'S': op = parse_plan::kSecond; break;
+      case 'z': op = parse_plan::kOffset; break;
+      case 'E':
+        if (end - cur >= 2 && cur[1] == 'z') {
+          op = parse_plan::kOffsetColon;
+          cur += 1;
+        } else if (end - cur >= 3 && cur[1] == '*' && cur[2] == 'z') {
+          op = parse_plan::kOffsetColon;
+          cur += 2;
+        } else {
+          ok = false;
+        }
+        break;
+      default:
+        ok = false;
+        break;
+    }
+    if (!ok) break;
+    flush_literal();
+    plan->steps.push_back(parse_plan::step{op, std::string()});
+    ++cur;
+  }
+  if (ok) {
+    flush_literal();
+    plan->ok = true;
+  } else {
+    plan->steps.clear();  // parse(plan, ...) will use the fallback
+  }
+  return plan;
+}
+
+bool parse_plan_ok(const parse_plan& plan) { return plan.ok; }
+
+// Parses the given input by replaying a compiled plan.  Produces
+// results identical to parse() with the plan's original specification.
+bool parse(const parse_plan& plan, char_range input, const time_zone& tz,
+           time_point<seconds>* sec, detail::femtoseconds* fs) {
+  if (!plan.ok) return parse(plan.fallback, input, tz, sec, fs);
+  CCTZ_STATS_COUNT(parse_call_count);
+  return ParsePlanned(plan, input, tz, sec, fs);
+}
+
 }  // namespace detail
+
+namespace debug {
+
+bool formatting_stats(format_stats* stats) {
+#if defined(CCTZ_ENABLE_STATS)
+  stats->format_calls = format_call_count.Value();
+  stats->format_strftime_fallbacks = format_strftime_fallback_count.Value();
+  stats->parse_calls = parse_call_count.Value();
+  stats->parse_strptime_fallbacks = parse_strptime_fallback_count.Value();
+  return true;
+#else
+  static_cast<void>(stats);
+  return false;
+#endif
+}
+
+}  // namespace debug
+
+void ResetFormatStats() {
+#if defined(CCTZ_ENABLE_STATS)
+  format_call_count.Reset();
+  format_strftime_fallback_count.Reset();
+  parse_call_count.Reset();
+  parse_strptime_fallback_count.Reset();
+#endif
+}
+
 }  // namespace cctz
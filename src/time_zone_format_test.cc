@@ -673,6 +673,128 @@ TEST(Format, RFC1123Format) {  // locale specific
   EXPECT_EQ("28 Jun 1977 09:08:07 -0700", format(RFC1123_no_wday, tp, tz));
 }
 
+TEST(Format, PrecompiledFormatter) {
+  time_zone tz;
+  EXPECT_TRUE(load_time_zone("America/Los_Angeles", &tz));
+
+  // A compiled specification produces output identical to format().
+  const char* const kFmts[] = {
+      RFC3339_full, RFC3339_sec, RFC1123_full, RFC1123_no_wday,
+      "%Y-%m-%d %H:%M:%S %z", "%a %A %b %B %c %p", "%j %U %u %V %w %W",
+      "100%% %Ez %E*z %:z %::z %:::z", "%E4Y%m%d", "%G-%g-%C-%y",
+  };
+  const civil_second kWhens[] = {
+      civil_second(1977, 6, 28, 9, 8, 7),
+      civil_second(2011, 3, 13, 2, 15, 0),   // PST->PDT gap
+      civil_second(2011, 11, 6, 1, 15, 0),   // PDT->PST repeat
+      civil_second(2016, 1, 1, 0, 0, 0),     // ISO year != year
+      civil_second(-77, 6, 28, 9, 8, 7),     // negative year
+      civil_second(12345, 2, 3, 4, 5, 6),    // five-digit year
+  };
+  for (const char* fmt : kFmts) {
+    const formatter f(fmt);
+    EXPECT_TRUE(f.ok()) << fmt;
+    for (const civil_second& when : kWhens) {
+      auto tp = convert(when, tz) + chrono::milliseconds(120);
+      EXPECT_EQ(format(fmt, tp, tz), f.format(tp, tz)) << fmt;
+    }
+  }
+
+  // A non-standard conversion is not compiled, but still formats
+  // correctly through the fallback path.
+  const formatter odd("%Y %Od");
+  EXPECT_FALSE(odd.ok());
+  auto tp = convert(kWhens[0], tz);
+  EXPECT_EQ(format("%Y %Od", tp, tz), odd.format(tp, tz));
+}
+
+#if __cpp_constexpr >= 201304 || (defined(_MSC_VER) && _MSC_VER >= 1910)
+TEST(Format, FormatCompiles) {
+  // Compile-time validation of a specification, agreeing with what the
+  // runtime compiler accepts (i.e., with formatter::ok()).
+  static_assert(format_compiles("%Y-%m-%dT%H:%M:%E*S%Ez"), "rfc3339");
+  static_assert(format_compiles("%a, %d %b %Y %H:%M:%S %z"), "rfc1123");
+  static_assert(format_compiles("100%% %Ez %E*z %:z %::z %:::z"), "offsets");
+  static_assert(format_compiles("%E4Y%m%d %E15f %E0S"), "extensions");
+  static_assert(format_compiles("plain text, no conversions"), "literal");
+  static_assert(format_compiles("50%"), "trailing percent");
+  static_assert(!format_compiles("%Y %Od"), "locale modifier");
+  static_assert(!format_compiles("%Q"), "unknown conversion");
+  static_assert(!format_compiles("%E5x"), "bad extension");
+  static_assert(!format_compiles("%::x"), "bad offset form");
+  static_assert(!format_compiles("%E1025S"), "too many digits");
+
+  EXPECT_TRUE(formatter("%Y-%m-%dT%H:%M:%E*S%Ez").ok());
+  EXPECT_FALSE(formatter("%Y %Od").ok());
+}
+#endif
+
+TEST(Format, FormatToBuffer) {
+  time_zone tz;
+  EXPECT_TRUE(load_time_zone("America/Los_Angeles", &tz));
+  auto tp = convert(civil_second(1977, 6, 28, 9, 8, 7), tz) +
+            chrono::milliseconds(120);
+
+  const formatter f(RFC3339_full);
+  const std::string expected = format(RFC3339_full, tp, tz);
+
+  char buf[64];
+  std::size_t len = f.format_to(tp, tz, buf, sizeof(buf));
+  EXPECT_EQ(expected.size(), len);
+  EXPECT_EQ(expected, std::string(buf, len));
+  EXPECT_EQ('\0', buf[len]);
+
+  // An exact fit (including the NUL) succeeds.
+  len = f.format_to(tp, tz, buf, expected.size() + 1);
+  EXPECT_EQ(expected.size(), len);
+  EXPECT_EQ(expected, std::string(buf, len));
+
+  // A too-small buffer reports failure.
+  EXPECT_EQ(0, f.format_to(tp, tz, buf, expected.size()));
+  EXPECT_EQ(0, f.format_to(tp, tz, buf, 0));
+
+  // The fallback path also honors the buffer bounds.
+  const formatter odd("%Y %Od");
+  EXPECT_FALSE(odd.ok());
+  const std::string odd_expected = format("%Y %Od", tp, tz);
+  len = odd.format_to(tp, tz, buf, sizeof(buf));
+  EXPECT_EQ(odd_expected.size(), len);
+  EXPECT_EQ(odd_expected, std::string(buf, len));
+  EXPECT_EQ(0, odd.format_to(tp, tz, buf, odd_expected.size()));
+}
+
+TEST(Format, CachedFormatter) {
+  time_zone tz;
+  EXPECT_TRUE(load_time_zone("America/Los_Angeles", &tz));
+  const time_zone utc = utc_time_zone();
+
+  const char* const kFmts[] = {
+      RFC3339_full, RFC3339_sec, "%Y-%m-%d %H:%M:%E6S %z",
+      "%E3f then %H:%M",  // subseconds ahead of other conversions
+      "%Y %Od",           // uncompilable; uses the fallback path
+  };
+
+  // Sweep across a DST boundary with varying subseconds, interleaving
+  // zones to exercise cache replacement.
+  for (const char* fmt : kFmts) {
+    cached_formatter cached(fmt);
+    const auto spring = convert(civil_second(2011, 3, 13, 1, 59, 58), tz);
+    for (int i = 0; i != 8; ++i) {
+      const auto tp = spring + chrono::milliseconds(i * 400);
+      EXPECT_EQ(format(fmt, tp, tz), cached.format(tp, tz)) << fmt << " " << i;
+      EXPECT_EQ(format(fmt, tp, utc), cached.format(tp, utc))
+          << fmt << " " << i;
+    }
+  }
+
+  // Multiple subsecond conversions disable the cache but still format
+  // correctly.
+  cached_formatter multi("%E3f %E3f");
+  const auto tp = convert(civil_second(2013, 6, 28, 19, 8, 9), tz) +
+                  chrono::milliseconds(120);
+  EXPECT_EQ(format("%E3f %E3f", tp, tz), multi.format(tp, tz));
+}
+
 //
 // Testing parse()
 //
@@ -1381,6 +1503,62 @@ TEST(Parse, RFC3339Format) {
   EXPECT_EQ(tp, tp2);
 }
 
+TEST(Parse, PrecompiledParser) {
+  time_zone tz;
+  EXPECT_TRUE(load_time_zone("America/Los_Angeles", &tz));
+
+  // A compiled specification agrees with parse(), including on inputs
+  // that should fail to parse.
+  const char* const kFmts[] = {
+      RFC3339_sec, "%Y-%m-%d %H:%M:%S %Ez", "%Y-%m-%dT%H:%M:%S%E*z",
+      "%m/%d/%Y %H:%M", "%H:%M:%S",
+  };
+  const char* const kInputs[] = {
+      "2013-06-28T19:08:09-07:00", "2013-06-28 19:08:09 -07:00",
+      "2013-06-28T19:08:09Z", "06/28/2013 19:08", "19:08:09",
+      "2013-6-8 09:08:09 -07:00", "2016-12-31 23:59:60 +00:00",
+      "9999-12-31 23:59:59 -07:00", "2013-09-31 19:08:09 -07:00",
+      "2013-06-28T19:08:09", "2013-06-28", "garbage", "",
+  };
+  for (const char* fmt : kFmts) {
+    const parser p(fmt);
+    EXPECT_TRUE(p.ok()) << fmt;
+    for (const char* input : kInputs) {
+      time_point<cctz::seconds> got, want;
+      const bool b = parse(fmt, input, tz, &want);
+      EXPECT_EQ(b, p.parse(input, tz, &got)) << fmt << " / " << input;
+      if (b) {
+        EXPECT_EQ(want, got) << fmt << " / " << input;
+      }
+    }
+  }
+
+  // A specification beyond the fixed-width subset is not compiled, but
+  // still parses correctly through the fallback path.
+  const parser odd(RFC3339_full);
+  EXPECT_FALSE(odd.ok());
+  time_point<chrono::nanoseconds> got_ns, want_ns;
+  EXPECT_TRUE(
+      parse(RFC3339_full, "2013-06-28T19:08:09.123456789-07:00", tz, &want_ns));
+  EXPECT_TRUE(odd.parse("2013-06-28T19:08:09.123456789-07:00", tz, &got_ns));
+  EXPECT_EQ(want_ns, got_ns);
+
+  // The bulk overload stops at the first input that fails to parse.
+  const parser rfc3339(RFC3339_sec);
+  const detail::char_range lines[] = {
+      "2013-06-28T19:08:09-07:00",
+      "2014-02-12T20:21:00Z",
+      "2014-02-12X20:21:00Z",  // bad separator
+      "2015-06-28T19:08:09-07:00",
+  };
+  time_point<cctz::seconds> tps[4];
+  EXPECT_EQ(2, rfc3339.parse(lines, 4, tz, tps));
+  EXPECT_EQ(convert(civil_second(2013, 6, 29, 2, 8, 9), utc_time_zone()),
+            tps[0]);
+  EXPECT_EQ(convert(civil_second(2014, 2, 12, 20, 21, 0), utc_time_zone()),
+            tps[1]);
+}
+
 TEST(Parse, MaxRange) {
   const time_zone utc = utc_time_zone();
   time_point<cctz::seconds> tp;
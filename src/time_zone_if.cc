@@ -27,10 +27,33 @@ std::unique_ptr<TimeZoneIf> TimeZoneIf::Load(const std::string& name) {
 
   // Otherwise use the "zoneinfo" implementation by default.
   std::unique_ptr<TimeZoneInfo> tz(new TimeZoneInfo);
-  if (!tz->Load(name)) tz.reset();
+  if (!tz->Load(name)) {
+    // A name matching no zoneinfo data may be a POSIX TZ rule string
+    // (e.g., ${TZ}="PST8PDT,M3.2.0,M11.1.0"), which libc would apply
+    // itself. Loading such specs natively gives them the same
+    // lock-free, hint-accelerated lookups as named zones.
+    if (!tz->ResetToPosixSpec(name)) tz.reset();
+  }
   return std::unique_ptr<TimeZoneIf>(tz.release());
 }
 
+void TimeZoneIf::BreakTimeBatch(const time_point<seconds>* tps, std::size_t n,
+                                time_zone::absolute_lookup* als) const {
+  for (std::size_t i = 0; i != n; ++i) als[i] = BreakTime(tps[i]);
+}
+
+void TimeZoneIf::TransitionRange(
+    const time_point<seconds>& from, const time_point<seconds>& to,
+    std::vector<time_zone::civil_transition>* trans) const {
+  time_zone::civil_transition t;
+  for (time_point<seconds> tp = from; NextTransition(tp, &t);) {
+    const time_point<seconds> when = MakeTime(t.to).trans;
+    if (when > to) break;
+    trans->push_back(t);
+    tp = when;
+  }
+}
+
 // Defined out-of-line to avoid emitting a weak vtable in all TUs.
 TimeZoneIf::~TimeZoneIf() {}
 
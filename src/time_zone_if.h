@@ -16,12 +16,15 @@
 #define CCTZ_TIME_ZONE_IF_H_
 
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "cctz/civil_time.h"
 #include "cctz/time_zone.h"
+#include "debug_stats.h"
 
 namespace cctz {
 
@@ -39,14 +42,39 @@ class TimeZoneIf {
   virtual time_zone::civil_lookup MakeTime(
       const civil_second& cs) const = 0;
 
+  // Bulk variant of BreakTime(). The default implementation simply
+  // loops, but subclasses may exploit temporal locality between
+  // consecutive time points to avoid repeated transition searches.
+  virtual void BreakTimeBatch(const time_point<seconds>* tps, std::size_t n,
+                              time_zone::absolute_lookup* als) const;
+
   virtual bool NextTransition(const time_point<seconds>& tp,
                               time_zone::civil_transition* trans) const = 0;
   virtual bool PrevTransition(const time_point<seconds>& tp,
                               time_zone::civil_transition* trans) const = 0;
 
+  // Appends, in order, the transitions that occur after "from" and at
+  // or before "to". The default implementation chains NextTransition()
+  // calls, but subclasses may position once and then walk their
+  // transition list sequentially.
+  virtual void TransitionRange(
+      const time_point<seconds>& from, const time_point<seconds>& to,
+      std::vector<time_zone::civil_transition>* trans) const;
+
   virtual std::string Version() const = 0;
   virtual std::string Description() const = 0;
 
+#if defined(CCTZ_ENABLE_STATS)
+  // Adds this zone's event counts to the counter fields of *stats (the
+  // zone_name field is the caller's concern). Counts are cumulative
+  // until ResetStats(). The defaults are for subclasses with no
+  // counters.
+  virtual void CollectStats(debug::zone_stats* stats) const {
+    static_cast<void>(stats);
+  }
+  virtual void ResetStats() const {}
+#endif
+
  protected:
   TimeZoneIf() {}
 };
@@ -14,11 +14,20 @@
 
 #include "time_zone_impl.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <deque>
+#include <future>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include "time_zone_fixed.h"
 
@@ -29,9 +38,15 @@ namespace {
 // time_zone::Impls are linked into a map to support fast lookup by name.
 using TimeZoneImplByName =
     std::unordered_map<std::string, const time_zone::Impl*>;
-TimeZoneImplByName* time_zone_map = nullptr;
 
-// Mutual exclusion for time_zone_map.
+// The published map of loaded time zones. Each map is immutable once
+// published, so lookups are lock free. Mutations copy the current map,
+// apply the change, and atomically publish the result (copy-on-write),
+// all under TimeZoneMutex(). Superseded maps (and their Impls) are never
+// deleted as lock-free readers may still be using them.
+std::atomic<const TimeZoneImplByName*> time_zone_map{nullptr};
+
+// Mutual exclusion for mutations of time_zone_map.
 std::mutex& TimeZoneMutex() {
   // This mutex is intentionally "leaked" to avoid the static deinitialization
   // order fiasco (std::mutex's destructor is not trivial on many platforms).
@@ -39,10 +54,76 @@ std::mutex& TimeZoneMutex() {
   return *time_zone_mutex;
 }
 
+// Retires a superseded map snapshot. The snapshots are logically
+// unreachable but not "leaked". See ClearTimeZoneMapTestOnly().
+void RetireTimeZoneMap(const TimeZoneImplByName* map) {
+  static auto* retired = new std::deque<const TimeZoneImplByName*>;
+  if (map != nullptr) retired->push_back(map);
+}
+
+// Retires zoneinfo data superseded by ReloadTimeZones(). In-flight
+// lookups may still be using the old data, so it is never deleted.
+void RetireTimeZoneIf(const TimeZoneIf* zone) {
+  static auto* retired = new std::deque<const TimeZoneIf*>;
+  if (zone != nullptr) retired->push_back(zone);
+}
+
+// The per-name table of zone loads currently in flight, so that
+// concurrent requests for one name share a single parse while loads for
+// different names proceed in parallel. An entry is created before
+// parsing begins and erased once the result is published in
+// time_zone_map, so every request resolves through exactly one of the
+// two tables.
+using InflightLoads =
+    std::unordered_map<std::string, std::shared_future<time_zone>>;
+
+InflightLoads& TimeZoneInflight() {
+  static auto* inflight = new InflightLoads;
+  return *inflight;
+}
+
+// Mutual exclusion for mutations of TimeZoneInflight(). Unlike
+// TimeZoneMutex(), this mutex is never held during disk I/O or TZif
+// parsing, so a thread loading one zone never stalls requests for
+// another. "Leaked" for the same reason as TimeZoneMutex().
+std::mutex& InflightMutex() {
+  static std::mutex* inflight_mutex = new std::mutex;
+  return *inflight_mutex;
+}
+
+// Wraps an already-loaded zone in a ready future.
+std::shared_future<time_zone> ReadyFuture(time_zone tz) {
+  std::promise<time_zone> ready;
+  ready.set_value(tz);
+  return ready.get_future().share();
+}
+
+// An interned fixed-offset zone. Entries are immutable once published
+// and are never deleted (the Impl is shared with the named-zone map).
+struct FixedZone {
+  std::int_fast64_t offset;  // seconds east of UTC
+  const time_zone::Impl* impl;
+};
+
+// A small, lock-free, open-addressed table of interned fixed-offset
+// zones, so that fixed_time_zone() need not build a zone name or probe
+// the named-zone map on repeat requests. Slots are claimed with a CAS;
+// readers are a single acquire load per probe. An offset that cannot
+// be placed within the probe limit simply goes uncached and falls back
+// to the named-zone map on every request.
+const std::size_t kFixedZoneSlots = 512;  // a power of two
+const std::size_t kFixedZoneProbes = 16;
+std::atomic<const FixedZone*> fixed_zones[kFixedZoneSlots];
+
+std::size_t FixedZoneSlot(std::int_fast64_t offset) {
+  const auto h = static_cast<std::uint_fast64_t>(offset) * 0x9e3779b97f4a7c15;
+  return static_cast<std::size_t>(h >> 32) % kFixedZoneSlots;
+}
+
 }  // namespace
 
 time_zone time_zone::Impl::UTC() {
-  return time_zone(UTCImpl());
+  return time_zone(nullptr);  // see time_zone::effective_impl()
 }
 
 bool time_zone::Impl::LoadTimeZone(detail::char_range name_range, time_zone* tz) {
@@ -52,66 +133,430 @@ bool time_zone::Impl::LoadTimeZone(detail::char_range name_range, time_zone* tz)
   // First check for UTC (which is never a key in time_zone_map).
   auto offset = seconds::zero();
   if (FixedOffsetFromName(name, &offset) && offset == seconds::zero()) {
-    *tz = time_zone(utc_impl);
+    *tz = UTC();
     return true;
   }
 
-  // Then check, under a shared lock, whether the time zone has already
-  // been loaded. This is the common path. TODO: Move to shared_mutex.
+  // Then check whether the time zone has already been loaded. This is
+  // the common path, and it runs lock free against the last published
+  // map snapshot.
+  if (const TimeZoneImplByName* old_map =
+          time_zone_map.load(std::memory_order_acquire)) {
+    TimeZoneImplByName::const_iterator itr = old_map->find(name);
+    if (itr != old_map->end()) {
+      *tz = (itr->second != utc_impl) ? time_zone(itr->second) : UTC();
+      return itr->second != utc_impl;
+    }
+  }
+
+  // The zone has not been published yet. Either begin the load on this
+  // thread, or share the future of a load already in flight for this
+  // name. Parsing happens without holding any lock, so a slow load never
+  // stalls requests for other zones.
+  std::shared_future<time_zone> fut;
+  std::shared_ptr<std::promise<time_zone>> prom;
   {
-    std::lock_guard<std::mutex> lock(TimeZoneMutex());
-    if (time_zone_map != nullptr) {
-      TimeZoneImplByName::const_iterator itr = time_zone_map->find(name);
-      if (itr != time_zone_map->end()) {
-        *tz = time_zone(itr->second);
+    std::lock_guard<std::mutex> lock(InflightMutex());
+    const TimeZoneImplByName* old_map =
+        time_zone_map.load(std::memory_order_acquire);
+    if (old_map != nullptr) {
+      TimeZoneImplByName::const_iterator itr = old_map->find(name);
+      if (itr != old_map->end()) {  // published while we waited
+        *tz = (itr->second != utc_impl) ? time_zone(itr->second) : UTC();
         return itr->second != utc_impl;
       }
     }
+    InflightLoads& inflight = TimeZoneInflight();
+    InflightLoads::const_iterator itr = inflight.find(name);
+    if (itr != inflight.end()) {
+      fut = itr->second;  // share the load already in flight
+    } else {
+      prom.reset(new std::promise<time_zone>());
+      fut = prom->get_future().share();
+      inflight.emplace(name, fut);
+    }
+  }
+  if (prom != nullptr) prom->set_value(LoadAndPublish(name));
+  *tz = fut.get();
+  return tz->impl_ != nullptr;  // the null impl (UTC) denotes failure
+}
+
+time_zone time_zone::Impl::LoadAndPublish(const std::string& name) {
+  const time_zone::Impl* const utc_impl = UTCImpl();
+
+  // Parse the zoneinfo data, without holding any lock.
+  const Impl* impl;
+  Impl* new_impl = new Impl(name);
+  std::unique_ptr<TimeZoneIf> zone = TimeZoneIf::Load(new_impl->name_);
+  if (zone == nullptr) {
+    delete new_impl;  // free the nascent Impl
+    new_impl = nullptr;
+    impl = utc_impl;  // and fallback to UTC
+  } else {
+    new_impl->zone_.store(zone.release(), std::memory_order_relaxed);
+    impl = new_impl;  // install new time zone
+  }
+
+  // Publish the result with a map swap. A zone that raced with a
+  // LoadTimeZones() call keeps its already-published Impl.
+  {
+    std::lock_guard<std::mutex> lock(TimeZoneMutex());
+    const TimeZoneImplByName* old_map =
+        time_zone_map.load(std::memory_order_relaxed);
+    std::unique_ptr<TimeZoneImplByName> new_map(
+        old_map != nullptr ? new TimeZoneImplByName(*old_map)
+                           : new TimeZoneImplByName);
+    const auto inserted = new_map->insert(std::make_pair(name, impl));
+    if (inserted.second) {
+      time_zone_map.store(new_map.release(), std::memory_order_release);
+      RetireTimeZoneMap(old_map);
+    } else {
+      delete new_impl;  // lost the race; free the nascent Impl
+      impl = inserted.first->second;
+    }
+  }
+
+  // Retire the in-flight table entry. The zone is published, so any new
+  // request now resolves through the map.
+  {
+    std::lock_guard<std::mutex> lock(InflightMutex());
+    TimeZoneInflight().erase(name);
+  }
+  return (impl != utc_impl) ? time_zone(impl) : UTC();
+}
+
+std::shared_future<time_zone> time_zone::Impl::LoadTimeZoneAsync(
+    const std::string& name) {
+  const time_zone::Impl* const utc_impl = UTCImpl();
+
+  // Zones already published resolve to a ready future without spawning
+  // a thread, as does "UTC" (which is never a key in time_zone_map).
+  auto offset = seconds::zero();
+  if (FixedOffsetFromName(name, &offset) && offset == seconds::zero()) {
+    return ReadyFuture(UTC());
+  }
+  if (const TimeZoneImplByName* old_map =
+          time_zone_map.load(std::memory_order_acquire)) {
+    TimeZoneImplByName::const_iterator itr = old_map->find(name);
+    if (itr != old_map->end()) {
+      return ReadyFuture((itr->second != utc_impl) ? time_zone(itr->second)
+                                                   : UTC());
+    }
+  }
+
+  // Otherwise share the future of a load already in flight for this
+  // name, or begin one on a background thread.
+  std::shared_future<time_zone> fut;
+  std::shared_ptr<std::promise<time_zone>> prom;
+  {
+    std::lock_guard<std::mutex> lock(InflightMutex());
+    const TimeZoneImplByName* old_map =
+        time_zone_map.load(std::memory_order_acquire);
+    if (old_map != nullptr) {
+      TimeZoneImplByName::const_iterator itr = old_map->find(name);
+      if (itr != old_map->end()) {  // published while we waited
+        return ReadyFuture((itr->second != utc_impl) ? time_zone(itr->second)
+                                                     : UTC());
+      }
+    }
+    InflightLoads& inflight = TimeZoneInflight();
+    InflightLoads::const_iterator itr = inflight.find(name);
+    if (itr != inflight.end()) return itr->second;
+    prom.reset(new std::promise<time_zone>());
+    fut = prom->get_future().share();
+    inflight.emplace(name, fut);
+  }
+  std::thread([name, prom]() { prom->set_value(LoadAndPublish(name)); })
+      .detach();
+  return fut;
+}
+
+time_zone time_zone::Impl::FixedTimeZone(const seconds& offset) {
+  // A zero or out-of-range offset names "UTC" (see FixedOffsetToName()),
+  // which is never a key in the interned table or the named-zone map.
+  if (offset == seconds::zero() || offset < std::chrono::hours(-24) ||
+      offset > std::chrono::hours(24)) {
+    return UTC();
   }
 
-  // Now check again, under an exclusive lock.
+  const std::int_fast64_t off = offset.count();
+  std::size_t slot = FixedZoneSlot(off);
+  std::size_t probes = 0;
+  for (; probes != kFixedZoneProbes; ++probes) {
+    const FixedZone* fz = fixed_zones[slot].load(std::memory_order_acquire);
+    if (fz == nullptr) break;  // claimable slot
+    if (fz->offset == off) return time_zone(fz->impl);
+    slot = (slot + 1) % kFixedZoneSlots;
+  }
+
+  // Missing: resolve through the named-zone map, so that the result is
+  // the very Impl that load_time_zone() would produce for this name,
+  // and then try to publish it for future requests.
+  time_zone tz;
+  LoadTimeZone(FixedOffsetToName(offset), &tz);
+  const FixedZone* fz = new FixedZone{off, tz.impl_};
+  for (; probes != kFixedZoneProbes; ++probes) {
+    const FixedZone* expected = nullptr;
+    if (fixed_zones[slot].compare_exchange_strong(
+            expected, fz, std::memory_order_acq_rel)) {
+      return tz;
+    }
+    if (expected->offset == off) break;  // someone else interned it
+    slot = (slot + 1) % kFixedZoneSlots;
+  }
+  delete fz;  // uninterned; fall back to the map again next time
+  return tz;
+}
+
+bool time_zone::Impl::LoadTimeZones(const std::vector<std::string>& names) {
+  const time_zone::Impl* const utc_impl = UTCImpl();
+  bool loaded_all = true;
+
+  // Collect the named zones not already published, dropping duplicates.
+  // A zone already published as the UTC fallback failed to load before.
+  std::vector<std::string> pending;
+  {
+    const TimeZoneImplByName* old_map =
+        time_zone_map.load(std::memory_order_acquire);
+    std::unordered_set<std::string> seen;
+    for (const std::string& name : names) {
+      auto offset = seconds::zero();
+      if (FixedOffsetFromName(name, &offset) && offset == seconds::zero()) {
+        continue;  // UTC is never a key in time_zone_map
+      }
+      if (old_map != nullptr) {
+        TimeZoneImplByName::const_iterator itr = old_map->find(name);
+        if (itr != old_map->end()) {
+          if (itr->second == utc_impl) loaded_all = false;
+          continue;
+        }
+      }
+      if (seen.insert(name).second) pending.push_back(name);
+    }
+  }
+  if (pending.empty()) return loaded_all;
+
+  // Load the missing zones on a set of worker threads, without holding
+  // TimeZoneMutex() so that the parsing can proceed in parallel. Note
+  // that this may call cctz_extension::zone_info_source_factory from
+  // multiple threads concurrently (see zone_info_source.h).
+  std::vector<Impl*> loaded(pending.size(), nullptr);
+  std::atomic<std::size_t> pos(0);
+  const auto worker = [&pending, &loaded, &pos]() {
+    for (;;) {
+      const std::size_t i = pos.fetch_add(1, std::memory_order_relaxed);
+      if (i >= pending.size()) break;
+      Impl* new_impl = new Impl(pending[i]);
+      std::unique_ptr<TimeZoneIf> zone = TimeZoneIf::Load(new_impl->name_);
+      if (zone == nullptr) {
+        delete new_impl;  // free the nascent Impl
+      } else {
+        new_impl->zone_.store(zone.release(), std::memory_order_relaxed);
+        loaded[i] = new_impl;
+      }
+    }
+  };
+  std::size_t nthreads = std::thread::hardware_concurrency();
+  if (nthreads == 0) nthreads = 1;
+  if (nthreads > pending.size()) nthreads = pending.size();
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < nthreads; ++i) threads.emplace_back(worker);
+  worker();  // the calling thread works too
+  for (std::thread& thread : threads) thread.join();
+
+  // Publish everything with a single map swap. A zone that raced with a
+  // load_time_zone() call keeps its already-published Impl.
   std::lock_guard<std::mutex> lock(TimeZoneMutex());
-  if (time_zone_map == nullptr) time_zone_map = new TimeZoneImplByName;
-  const Impl*& impl = (*time_zone_map)[name];
-  if (impl == nullptr) {
-    // The first thread in loads the new time zone.
-    Impl* new_impl = new Impl(name);
-    new_impl->zone_ = TimeZoneIf::Load(new_impl->name_);
-    if (new_impl->zone_ == nullptr) {
-      delete new_impl;  // free the nascent Impl
-      impl = utc_impl;  // and fallback to UTC
+  const TimeZoneImplByName* old_map =
+      time_zone_map.load(std::memory_order_relaxed);
+  std::unique_ptr<TimeZoneImplByName> new_map(
+      old_map != nullptr ? new TimeZoneImplByName(*old_map)
+                         : new TimeZoneImplByName);
+  for (std::size_t i = 0; i != pending.size(); ++i) {
+    const Impl* impl = (loaded[i] != nullptr) ? loaded[i] : utc_impl;
+    const auto inserted = new_map->insert(std::make_pair(pending[i], impl));
+    if (!inserted.second) {
+      delete loaded[i];  // lost the race; free the nascent Impl
+      impl = inserted.first->second;
+    }
+    if (impl == utc_impl) loaded_all = false;
+  }
+  time_zone_map.store(new_map.release(), std::memory_order_release);
+  RetireTimeZoneMap(old_map);
+  return loaded_all;
+}
+
+bool time_zone::Impl::ReloadTimeZones() {
+  const time_zone::Impl* const utc_impl = UTCImpl();
+
+  // Serialize reloads, and exclude concurrent map mutations so that the
+  // set of published zones is stable while we work. Lookups continue to
+  // run lock free against the old zoneinfo data in the meantime.
+  std::lock_guard<std::mutex> lock(TimeZoneMutex());
+  const TimeZoneImplByName* old_map =
+      time_zone_map.load(std::memory_order_relaxed);
+  if (old_map == nullptr) return true;  // no zones have been loaded
+
+  // Partition the published zones into Impls to refresh in place and
+  // names that failed to load before, which we retry. The map holds
+  // const pointers, but every non-UTC Impl was allocated (mutable) by
+  // LoadTimeZone() or LoadTimeZones(), so shedding the const is safe.
+  std::vector<Impl*> impls;
+  std::vector<std::string> retries;
+  for (const auto& element : *old_map) {
+    if (element.second == utc_impl) {
+      retries.push_back(element.first);
+    } else {
+      impls.push_back(const_cast<Impl*>(element.second));
+    }
+  }
+
+  // Re-parse the zoneinfo data on a set of worker threads.
+  std::vector<const TimeZoneIf*> fresh(impls.size(), nullptr);
+  std::vector<Impl*> retried(retries.size(), nullptr);
+  const std::size_t njobs = impls.size() + retries.size();
+  std::atomic<std::size_t> pos(0);
+  const auto worker = [&impls, &retries, &fresh, &retried, &pos, njobs]() {
+    for (;;) {
+      const std::size_t i = pos.fetch_add(1, std::memory_order_relaxed);
+      if (i >= njobs) break;
+      if (i < impls.size()) {
+        fresh[i] = TimeZoneIf::Load(impls[i]->name_).release();
+      } else {
+        const std::size_t j = i - impls.size();
+        Impl* new_impl = new Impl(retries[j]);
+        std::unique_ptr<TimeZoneIf> zone = TimeZoneIf::Load(new_impl->name_);
+        if (zone == nullptr) {
+          delete new_impl;  // still fails; free the nascent Impl
+        } else {
+          new_impl->zone_.store(zone.release(), std::memory_order_relaxed);
+          retried[j] = new_impl;
+        }
+      }
+    }
+  };
+  std::size_t nthreads = std::thread::hardware_concurrency();
+  if (nthreads == 0) nthreads = 1;
+  if (nthreads > njobs) nthreads = njobs;
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < nthreads; ++i) threads.emplace_back(worker);
+  worker();  // the calling thread works too
+  for (std::thread& thread : threads) thread.join();
+
+  // Swap the fresh data into the existing published Impls, retiring the
+  // replaced data. A zone whose data can no longer be parsed keeps its
+  // old data rather than degrading to UTC.
+  bool reloaded_all = true;
+  for (std::size_t i = 0; i != impls.size(); ++i) {
+    if (fresh[i] == nullptr) {
+      reloaded_all = false;
     } else {
-      impl = new_impl;  // install new time zone
+      RetireTimeZoneIf(
+          impls[i]->zone_.exchange(fresh[i], std::memory_order_acq_rel));
     }
   }
-  *tz = time_zone(impl);
-  return impl != utc_impl;
+
+  // Publish a new map if any previously failed zone now loads.
+  std::unique_ptr<TimeZoneImplByName> new_map;
+  for (std::size_t j = 0; j != retries.size(); ++j) {
+    if (retried[j] == nullptr) {
+      reloaded_all = false;
+    } else {
+      if (new_map == nullptr) {
+        new_map.reset(new TimeZoneImplByName(*old_map));
+      }
+      (*new_map)[retries[j]] = retried[j];
+    }
+  }
+  if (new_map != nullptr) {
+    time_zone_map.store(new_map.release(), std::memory_order_release);
+    RetireTimeZoneMap(old_map);
+  }
+  return reloaded_all;
 }
 
 void time_zone::Impl::ClearTimeZoneMapTestOnly() {
   std::lock_guard<std::mutex> lock(TimeZoneMutex());
-  if (time_zone_map != nullptr) {
+  const TimeZoneImplByName* old_map =
+      time_zone_map.load(std::memory_order_relaxed);
+  if (old_map != nullptr) {
     // Existing time_zone::Impl* entries are in the wild, so we can't delete
     // them. Instead, we move them to a private container, where they are
     // logically unreachable but not "leaked".  Future requests will result
     // in reloading the data.
     static auto* cleared = new std::deque<const time_zone::Impl*>;
-    for (const auto& element : *time_zone_map) {
+    for (const auto& element : *old_map) {
       cleared->push_back(element.second);
     }
-    time_zone_map->clear();
+    time_zone_map.store(nullptr, std::memory_order_release);
+    RetireTimeZoneMap(old_map);
   }
 }
 
-time_zone::Impl::Impl(detail::char_range name) : name_(name.begin, name.end) {}
+time_zone::Impl::Impl(detail::char_range name)
+    : name_(name.begin, name.end), zone_(nullptr) {}
 
 const time_zone::Impl* time_zone::Impl::UTCImpl() {
   static Impl* utc_impl = [] {
     Impl* impl = new Impl("UTC");
-    impl->zone_ = TimeZoneIf::Load(impl->name_);  // never fails
+    impl->zone_.store(TimeZoneIf::Load(impl->name_).release(),  // never fails
+                      std::memory_order_relaxed);
     return impl;
   }();
   return utc_impl;
 }
 
+#if defined(CCTZ_ENABLE_STATS)
+void time_zone::Impl::CollectStats(std::vector<debug::zone_stats>* stats) {
+  const Impl* const utc_impl = UTCImpl();
+  debug::zone_stats utc_stats;
+  utc_stats.zone_name = utc_impl->Name();
+  utc_impl->ZoneIf()->CollectStats(&utc_stats);
+  stats->push_back(std::move(utc_stats));
+  if (const TimeZoneImplByName* map =
+          time_zone_map.load(std::memory_order_acquire)) {
+    for (const auto& element : *map) {
+      if (element.second == utc_impl) continue;  // zones that failed to load
+      debug::zone_stats zs;
+      zs.zone_name = element.first;
+      element.second->ZoneIf()->CollectStats(&zs);
+      stats->push_back(std::move(zs));
+    }
+  }
+}
+
+void time_zone::Impl::ResetStats() {
+  const Impl* const utc_impl = UTCImpl();
+  utc_impl->ZoneIf()->ResetStats();
+  if (const TimeZoneImplByName* map =
+          time_zone_map.load(std::memory_order_acquire)) {
+    for (const auto& element : *map) {
+      if (element.second == utc_impl) continue;
+      element.second->ZoneIf()->ResetStats();
+    }
+  }
+}
+#endif
+
+namespace debug {
+
+bool zone_conversion_stats(std::vector<zone_stats>* stats) {
+#if defined(CCTZ_ENABLE_STATS)
+  time_zone::Impl::CollectStats(stats);
+  return true;
+#else
+  static_cast<void>(stats);
+  return false;
+#endif
+}
+
+void reset_stats() {
+#if defined(CCTZ_ENABLE_STATS)
+  time_zone::Impl::ResetStats();
+  ResetFormatStats();
+#endif
+}
+
+}  // namespace debug
+
 }  // namespace cctz
@@ -15,8 +15,11 @@
 #ifndef CCTZ_TIME_ZONE_IMPL_H_
 #define CCTZ_TIME_ZONE_IMPL_H_
 
+#include <atomic>
+#include <future>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "cctz/civil_time.h"
 #include "cctz/time_zone.h"
@@ -28,17 +31,58 @@ namespace cctz {
 // time_zone::Impl is the internal object referenced by a cctz::time_zone.
 class time_zone::Impl {
  public:
-  // The UTC time zone. Also used for other time zones that fail to load.
+  // The UTC time zone, as the canonical null-impl handle recognized by
+  // the fast paths in time_zone::lookup(). Zones that fail to load also
+  // yield this handle.
   static time_zone UTC();
 
+  // The Impl behind every UTC handle, for time_zone operations (name(),
+  // transitions, etc.) that need real zoneinfo data. Never fails.
+  static const Impl* UTCImpl();
+
   // Load a named time zone. Returns false if the name is invalid, or if
   // some other kind of error occurs. Note that loading "UTC" never fails.
   static bool LoadTimeZone(detail::char_range name, time_zone* tz);
 
+  // Begins loading the named time zone without blocking the caller on
+  // any disk I/O or TZif parsing, returning a future for the published
+  // zone (UTC on failure, as with LoadTimeZone()). Requests are deduped
+  // by name through the in-flight table, and loads for different names
+  // proceed in parallel. See cctz::load_time_zone_async().
+  static std::shared_future<time_zone> LoadTimeZoneAsync(
+      const std::string& name);
+
+  // Returns the fixed-offset time zone for the given offset, interning
+  // the result so that repeat requests are lock free and allocation
+  // free. The returned zone is the same Impl that loading the zone's
+  // canonical "Fixed/UTC..." name would produce. See
+  // cctz::fixed_time_zone().
+  static time_zone FixedTimeZone(const seconds& offset);
+
+  // Loads all the named time zones, parsing the zoneinfo data on worker
+  // threads without holding any lock, and publishes the results with a
+  // single map swap. Returns false if any name was invalid, or if some
+  // other kind of error occurred. See cctz::load_time_zones().
+  static bool LoadTimeZones(const std::vector<std::string>& names);
+
+  // Re-parses the zoneinfo data for every loaded time zone, atomically
+  // swapping the fresh data into the existing published Impls so that
+  // outstanding time_zone handles observe the new rules. Returns false
+  // if any zone's data could not be refreshed. See
+  // cctz::reload_time_zones().
+  static bool ReloadTimeZones();
+
   // Clears the map of cached time zones.  Primarily for use in benchmarks
   // that gauge the performance of loading/parsing the time-zone data.
   static void ClearTimeZoneMapTestOnly();
 
+#if defined(CCTZ_ENABLE_STATS)
+  // Implement debug::zone_conversion_stats() and debug::reset_stats()
+  // over every loaded zone (including UTC, which is never in the map).
+  static void CollectStats(std::vector<debug::zone_stats>* stats);
+  static void ResetStats();
+#endif
+
   // The primary key is the time-zone ID (e.g., "America/New_York").
   const std::string& Name() const {
     // TODO: It would nice if the zoneinfo data included the zone name.
@@ -47,38 +91,64 @@ class time_zone::Impl {
 
   // Breaks a time_point down to civil-time components in this time zone.
   time_zone::absolute_lookup BreakTime(const time_point<seconds>& tp) const {
-    return zone_->BreakTime(tp);
+    return ZoneIf()->BreakTime(tp);
+  }
+
+  // Bulk variant of BreakTime() for arrays of time points.
+  void BreakTimeBatch(const time_point<seconds>* tps, std::size_t n,
+                      time_zone::absolute_lookup* als) const {
+    ZoneIf()->BreakTimeBatch(tps, n, als);
   }
 
   // Converts the civil-time components in this time zone into a time_point.
   // That is, the opposite of BreakTime(). The requested civil time may be
   // ambiguous or illegal due to a change of UTC offset.
   time_zone::civil_lookup MakeTime(const civil_second& cs) const {
-    return zone_->MakeTime(cs);
+    return ZoneIf()->MakeTime(cs);
   }
 
   // Finds the time of the next/previous offset change in this time zone.
   bool NextTransition(const time_point<seconds>& tp,
                       time_zone::civil_transition* trans) const {
-    return zone_->NextTransition(tp, trans);
+    return ZoneIf()->NextTransition(tp, trans);
   }
   bool PrevTransition(const time_point<seconds>& tp,
                       time_zone::civil_transition* trans) const {
-    return zone_->PrevTransition(tp, trans);
+    return ZoneIf()->PrevTransition(tp, trans);
+  }
+
+  // Appends all the offset changes in (from, to] to *trans, in order.
+  void TransitionRange(const time_point<seconds>& from,
+                       const time_point<seconds>& to,
+                       std::vector<time_zone::civil_transition>* trans) const {
+    return ZoneIf()->TransitionRange(from, to, trans);
   }
 
   // Returns an implementation-defined version string for this time zone.
-  std::string Version() const { return zone_->Version(); }
+  std::string Version() const { return ZoneIf()->Version(); }
 
   // Returns an implementation-defined description of this time zone.
-  std::string Description() const { return zone_->Description(); }
+  std::string Description() const { return ZoneIf()->Description(); }
 
  private:
   explicit Impl(detail::char_range name);
-  static const Impl* UTCImpl();
+
+  // Parses the named zone's data without holding any lock, publishes
+  // the result (or UTC, on failure) in the map, and retires the zone's
+  // in-flight table entry. Returns the published handle, with the
+  // canonical null impl denoting failure.
+  static time_zone LoadAndPublish(const std::string& name);
+
+  // The current zoneinfo data for this zone. The data is immutable once
+  // published, but ReloadTimeZones() may replace the pointer with fresh
+  // data (retiring, not deleting, the old, as in-flight lookups may
+  // still be using it).
+  const TimeZoneIf* ZoneIf() const {
+    return zone_.load(std::memory_order_acquire);
+  }
 
   const std::string name_;
-  std::unique_ptr<TimeZoneIf> zone_;
+  std::atomic<const TimeZoneIf*> zone_;
 };
 
 }  // namespace cctz
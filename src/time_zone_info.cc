@@ -32,6 +32,14 @@
 
 #include "time_zone_info.h"
 
+#if !defined(_WIN32) && !defined(_MSC_VER)
+#define CCTZ_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include <algorithm>
 #include <cassert>
 #include <chrono>
@@ -42,8 +50,11 @@
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
 
 #include "cctz/civil_time.h"
 #include "time_zone_fixed.h"
@@ -70,9 +81,6 @@ const std::int_least16_t kMonthOffsets[2][1 + 12 + 1] = {
 // We reject leap-second encoded zoneinfo and so assume 60-second minutes.
 const std::int_least32_t kSecsPerDay = 24 * 60 * 60;
 
-// 400-year chunks always have 146097 days (20871 weeks).
-const std::int_least64_t kSecsPer400Years = 146097LL * kSecsPerDay;
-
 // Like kDaysPerYear[] but scaled up by a factor of kSecsPerDay.
 const std::int_least32_t kSecsPerYear[2] = {
   365 * kSecsPerDay,
@@ -108,6 +116,62 @@ std::int_fast64_t Decode64(const char* cp) {
   return static_cast<std::int_fast64_t>(v - s64maxU - 1) - s64max - 1;
 }
 
+// Encoders matching Decode8/Decode32/Decode64, used for the
+// compiled-zone cache records.
+void Encode8(std::string* out, std::uint_fast8_t v) {
+  out->push_back(static_cast<char>(v & 0xff));
+}
+
+void Encode32(std::string* out, std::int_fast32_t v) {
+  const auto u = static_cast<std::uint_fast32_t>(v);
+  for (int i = (32 / 8) - 1; i >= 0; --i) {
+    out->push_back(static_cast<char>((u >> (8 * i)) & 0xff));
+  }
+}
+
+void Encode64(std::string* out, std::int_fast64_t v) {
+  const auto u = static_cast<std::uint_fast64_t>(v);
+  for (int i = (64 / 8) - 1; i >= 0; --i) {
+    out->push_back(static_cast<char>((u >> (8 * i)) & 0xff));
+  }
+}
+
+// A civil_second is encoded as an 8-byte year plus one byte for each
+// of the month/day/hour/minute/second fields.
+const std::size_t kEncodedCivilLen = 8 + 5;
+
+void EncodeCivil(std::string* out, const civil_second& cs) {
+  Encode64(out, cs.year());
+  Encode8(out, static_cast<std::uint_fast8_t>(cs.month()));
+  Encode8(out, static_cast<std::uint_fast8_t>(cs.day()));
+  Encode8(out, static_cast<std::uint_fast8_t>(cs.hour()));
+  Encode8(out, static_cast<std::uint_fast8_t>(cs.minute()));
+  Encode8(out, static_cast<std::uint_fast8_t>(cs.second()));
+}
+
+civil_second DecodeCivil(const char* cp) {
+  return civil_second(Decode64(cp), Decode8(cp + 8), Decode8(cp + 9),
+                      Decode8(cp + 10), Decode8(cp + 11), Decode8(cp + 12));
+}
+
+// The layout of a compiled-zone cache record (all multi-byte values
+// MSB first, like the TZif encoding):
+//
+//   8-byte magic ("tzcache" + format version)
+//   5 x 4-byte counts: timecnt typecnt charcnt speclen verslen
+//   1-byte default transition type, 1-byte extended flag
+//   8-byte last year of the stored transitions
+//   typecnt x (4-byte offset, 1-byte is_dst, 1-byte abbr index,
+//              encoded civil_max, encoded civil_min)
+//   timecnt x (8-byte unix_time, 1-byte type index,
+//              encoded civil_sec, encoded prev_civil_sec)
+//   charcnt bytes of abbreviations, speclen bytes of future spec,
+//   verslen bytes of version
+const char kCompiledCacheMagic[] = "tzcache2";
+const std::size_t kCompiledCacheMagicLen = sizeof(kCompiledCacheMagic) - 1;
+const std::size_t kEncodedTypeLen = 4 + 1 + 1 + 2 * kEncodedCivilLen;
+const std::size_t kEncodedTransitionLen = 8 + 1 + 2 * kEncodedCivilLen;
+
 // Generate a year-relative offset for a PosixTransition.
 std::int_fast64_t TransOffset(bool leap_year, int jan1_weekday,
                               const PosixTransition& pt) {
@@ -149,46 +213,63 @@ inline time_zone::civil_lookup MakeUnique(std::int_fast64_t unix_time) {
   return MakeUnique(FromUnixSeconds(unix_time));
 }
 
-inline time_zone::civil_lookup MakeSkipped(const Transition& tr,
+inline time_zone::civil_lookup MakeSkipped(std::int_fast64_t unix_time,
+                                           const civil_second& civil_sec,
+                                           const civil_second& prev_civil_sec,
                                            const civil_second& cs) {
   time_zone::civil_lookup cl;
   cl.kind = time_zone::civil_lookup::SKIPPED;
-  cl.pre = FromUnixSeconds(tr.unix_time - 1 + (cs - tr.prev_civil_sec));
-  cl.trans = FromUnixSeconds(tr.unix_time);
-  cl.post = FromUnixSeconds(tr.unix_time - (tr.civil_sec - cs));
+  cl.pre = FromUnixSeconds(unix_time - 1 + (cs - prev_civil_sec));
+  cl.trans = FromUnixSeconds(unix_time);
+  cl.post = FromUnixSeconds(unix_time - (civil_sec - cs));
   return cl;
 }
 
-inline time_zone::civil_lookup MakeRepeated(const Transition& tr,
+inline time_zone::civil_lookup MakeRepeated(std::int_fast64_t unix_time,
+                                            const civil_second& civil_sec,
+                                            const civil_second& prev_civil_sec,
                                             const civil_second& cs) {
   time_zone::civil_lookup cl;
   cl.kind = time_zone::civil_lookup::REPEATED;
-  cl.pre = FromUnixSeconds(tr.unix_time - 1 - (tr.prev_civil_sec - cs));
-  cl.trans = FromUnixSeconds(tr.unix_time);
-  cl.post = FromUnixSeconds(tr.unix_time + (cs - tr.civil_sec));
+  cl.pre = FromUnixSeconds(unix_time - 1 - (prev_civil_sec - cs));
+  cl.trans = FromUnixSeconds(unix_time);
+  cl.post = FromUnixSeconds(unix_time + (cs - civil_sec));
   return cl;
 }
 
-inline civil_second YearShift(const civil_second& cs, year_t shift) {
-  return civil_second(cs.year() + shift, cs.month(), cs.day(),
-                      cs.hour(), cs.minute(), cs.second());
+// The unix time of a future transition occurring at the given wall time
+// under the given (pre-transition) UTC offset, saturating rather than
+// overflowing at the end of the time line.
+std::int_fast64_t FutureUnix(const civil_second& wall,
+                             std::int_fast32_t utc_offset) {
+  static const civil_second max_civil =
+      civil_second() + std::numeric_limits<std::int_fast64_t>::max();
+  const civil_second utc = wall - utc_offset;
+  if (utc > max_civil) return std::numeric_limits<std::int_fast64_t>::max();
+  return utc - civil_second();
 }
 
 }  // namespace
 
 // What (no leap-seconds) UTC+seconds zoneinfo would look like.
 bool TimeZoneInfo::ResetToBuiltinUTC(const seconds& offset) {
-  transition_types_.resize(1);
-  TransitionType& tt(transition_types_.back());
+  std::vector<TransitionType> types(1);
+  TransitionType& tt(types.back());
   tt.utc_offset = static_cast<std::int_least32_t>(offset.count());
   tt.is_dst = false;
   tt.abbr_index = 0;
 
+  std::string abbrs = FixedOffsetToAbbr(offset);
+  abbrs.append(1, '\0');  // add NUL
+  // Temporarily view the scratch abbreviations so that LocalTime() works
+  // while building; CommitToArena() repoints the view into the arena.
+  abbreviations_ = ArenaSpan<char>(abbrs.data(), abbrs.size());
+
   // We temporarily add some redundant, contemporary (2013 through 2023)
   // transitions for performance reasons.  See TimeZoneInfo::LocalTime().
   // TODO: Fix the performance issue and remove the extra transitions.
-  transitions_.clear();
-  transitions_.reserve(12);
+  Transitions trans;
+  trans.reserve(13);
   for (const std::int_fast64_t unix_time : {
            -(1LL << 59),  // BIG_BANG
            1356998400LL,  // 2013-01-01T00:00:00+00:00
@@ -204,23 +285,132 @@ bool TimeZoneInfo::ResetToBuiltinUTC(const seconds& offset) {
            1672531200LL,  // 2023-01-01T00:00:00+00:00
            2147483647LL,  // 2^31 - 1
        }) {
-    Transition& tr(*transitions_.emplace(transitions_.end()));
-    tr.unix_time = unix_time;
-    tr.type_index = 0;
-    tr.civil_sec = LocalTime(tr.unix_time, tt).cs;
-    tr.prev_civil_sec = tr.civil_sec - 1;
+    const civil_second civil_sec = LocalTime(unix_time, tt).cs;
+    trans.unix_time.push_back(unix_time);
+    trans.type_index.push_back(0);
+    trans.civil_sec.push_back(civil_sec);
+    trans.prev_civil_sec.push_back(civil_sec - 1);
   }
 
   default_transition_type_ = 0;
-  abbreviations_ = FixedOffsetToAbbr(offset);
-  abbreviations_.append(1, '\0');  // add NUL
   future_spec_.clear();  // never needed for a fixed-offset zone
   extended_ = false;
 
   tt.civil_max = LocalTime(seconds::max().count(), tt).cs;
   tt.civil_min = LocalTime(seconds::min().count(), tt).cs;
 
-  transitions_.shrink_to_fit();
+  CommitToArena(trans, types, abbrs);
+  return true;
+}
+
+bool TimeZoneInfo::ResetToPosixSpec(const std::string& spec) {
+  PosixTimeZone posix;
+  if (!ParsePosixSpec(spec, &posix)) return false;
+  if (posix.std_offset >= kSecsPerDay || posix.std_offset <= -kSecsPerDay)
+    return false;
+
+  // The standard transition type, plus the daylight-saving type when
+  // the spec carries rules.
+  std::vector<TransitionType> types(1);
+  types[0].utc_offset = static_cast<std::int_least32_t>(posix.std_offset);
+  types[0].is_dst = false;
+  types[0].abbr_index = 0;
+  std::string abbrs = posix.std_abbr;
+  abbrs.append(1, '\0');  // add NUL
+  const bool has_dst = !posix.dst_abbr.empty();
+  if (has_dst) {
+    if (posix.dst_offset >= kSecsPerDay || posix.dst_offset <= -kSecsPerDay)
+      return false;
+    types.resize(2);
+    types[1].utc_offset = static_cast<std::int_least32_t>(posix.dst_offset);
+    types[1].is_dst = true;
+    types[1].abbr_index = static_cast<std::uint_least8_t>(abbrs.size());
+    abbrs += posix.dst_abbr;
+    abbrs.append(1, '\0');  // add NUL
+  }
+  // Temporarily view the scratch abbreviations so that LocalTime() works
+  // while building; CommitToArena() repoints the view into the arena.
+  abbreviations_ = ArenaSpan<char>(abbrs.data(), abbrs.size());
+
+  default_transition_type_ = 0;
+  version_.clear();
+  future_spec_ = spec;
+
+  Transitions trans;
+  trans.reserve(4);  // ExtendTransitions() might add one
+  trans.resize(1);
+  trans.unix_time[0] = -(1LL << 59);  // see tz/zic.c "BIG_BANG"
+  trans.type_index[0] = 0;
+
+  if (has_dst) {
+    // Materialize the rule pair for each year from 1900 through a
+    // contemporary year, as successive zic-generated transitions would
+    // (earlier times use the standard offset, as with zoneinfo data
+    // that predates its rules). ExtendTransitions() then owns every
+    // later year, evaluating the rules on demand after checking them
+    // over a full 400-year cycle.
+    const year_t first_year = 1900;
+    const year_t last_year = 2018;
+    const civil_day jan1(first_year, 1, 1);
+    std::int_fast64_t jan1_time = civil_second(jan1) - civil_second();
+    int jan1_weekday = (static_cast<int>(get_weekday(jan1)) + 1) % 7;
+    bool leap_year = IsLeap(first_year);
+    trans.reserve(2 * static_cast<std::size_t>(last_year - first_year + 1) +
+                  2);
+    for (year_t year = first_year; year <= last_year; ++year) {
+      const std::int_fast64_t dst_start_time =
+          jan1_time + TransOffset(leap_year, jan1_weekday, posix.dst_start) -
+          posix.std_offset;
+      const std::int_fast64_t dst_end_time =
+          jan1_time + TransOffset(leap_year, jan1_weekday, posix.dst_end) -
+          posix.dst_offset;
+      const std::size_t i = trans.size();
+      trans.resize(i + 2);
+      if (dst_start_time < dst_end_time) {  // dst within the year
+        trans.unix_time[i] = dst_start_time;
+        trans.type_index[i] = 1;
+        trans.unix_time[i + 1] = dst_end_time;
+        trans.type_index[i + 1] = 0;
+      } else {  // dst over the year boundary
+        trans.unix_time[i] = dst_end_time;
+        trans.type_index[i] = 0;
+        trans.unix_time[i + 1] = dst_start_time;
+        trans.type_index[i + 1] = 1;
+      }
+      if (!(trans.unix_time[i] < trans.unix_time[i + 1]))
+        return false;  // coincident rule transitions
+      jan1_time += kSecsPerYear[leap_year];
+      jan1_weekday = (jan1_weekday + kDaysPerYear[leap_year]) % 7;
+      leap_year = !leap_year && IsLeap(year + 1);
+    }
+  }
+
+  // Extend the transitions using the rules, exactly as for the trailing
+  // specification of a TZif file.
+  Header hdr{};  // only timecnt is examined
+  hdr.timecnt = trans.size();
+  ExtendTransitions(spec, hdr, types, &trans);
+
+  // Compute the local civil time for each transition and the preceding
+  // second, as Load() does after its own extension.
+  const TransitionType* ttp = &types[default_transition_type_];
+  for (std::size_t i = 0; i != trans.size(); ++i) {
+    const std::int_fast64_t unix_time = trans.unix_time[i];
+    trans.prev_civil_sec[i] = LocalTime(unix_time, *ttp).cs - 1;
+    ttp = &types[trans.type_index[i]];
+    trans.civil_sec[i] = LocalTime(unix_time, *ttp).cs;
+    if (i != 0) {
+      if (!(trans.civil_sec[i - 1] < trans.civil_sec[i]))
+        return false;  // out of order
+    }
+  }
+
+  for (auto& tt : types) {
+    tt.civil_max = LocalTime(seconds::max().count(), tt).cs;
+    tt.civil_min = LocalTime(seconds::min().count(), tt).cs;
+  }
+
+  CommitToArena(trans, types, abbrs);
   return true;
 }
 
@@ -273,11 +463,9 @@ void TimeZoneInfo::CheckTransition(const std::string& name,
 // zic(8) can generate no-op transitions when a zone changes rules at an
 // instant when there is actually no discontinuity.  So we check whether
 // two transitions have equivalent types (same offset/is_dst/abbr).
-bool TimeZoneInfo::EquivTransitions(std::uint_fast8_t tt1_index,
-                                    std::uint_fast8_t tt2_index) const {
-  if (tt1_index == tt2_index) return true;
-  const TransitionType& tt1(transition_types_[tt1_index]);
-  const TransitionType& tt2(transition_types_[tt2_index]);
+bool TimeZoneInfo::EquivTransitions(const TransitionType& tt1,
+                                    const TransitionType& tt2) {
+  if (&tt1 == &tt2) return true;
   if (tt1.is_dst != tt2.is_dst) return false;
   if (tt1.utc_offset != tt2.utc_offset) return false;
   if (tt1.abbr_index != tt2.abbr_index) return false;
@@ -287,7 +475,9 @@ bool TimeZoneInfo::EquivTransitions(std::uint_fast8_t tt1_index,
 // Use the POSIX-TZ-environment-variable-style string to handle times
 // in years after the last transition stored in the zoneinfo data.
 void TimeZoneInfo::ExtendTransitions(const std::string& name,
-                                     const Header& hdr) {
+                                     const Header& hdr,
+                                     const std::vector<TransitionType>& types,
+                                     Transitions* trans) {
   extended_ = false;
   bool extending = !future_spec_.empty();
 
@@ -301,8 +491,8 @@ void TimeZoneInfo::ExtendTransitions(const std::string& name,
     // The future specification should match the last/default transition,
     // and that means that handling the future will fall out naturally.
     std::uint_fast8_t index = default_transition_type_;
-    if (hdr.timecnt != 0) index = transitions_[hdr.timecnt - 1].type_index;
-    const TransitionType& tt(transition_types_[index]);
+    if (hdr.timecnt != 0) index = trans->type_index[hdr.timecnt - 1];
+    const TransitionType& tt(types[index]);
     CheckTransition(name, tt, posix.std_offset, false, posix.std_abbr);
     extending = false;
   }
@@ -312,80 +502,99 @@ void TimeZoneInfo::ExtendTransitions(const std::string& name,
     extending = false;
   }
 
-  if (!extending) {
-    // Ensure that there is always a transition in the second half of the
-    // time line (the BIG_BANG transition is in the first half) so that the
-    // signed difference between a civil_second and the civil_second of its
-    // previous transition is always representable, without overflow.
-    const Transition& last(transitions_.back());
-    if (last.unix_time < 0) {
-      const std::uint_fast8_t type_index = last.type_index;
-      Transition& tr(*transitions_.emplace(transitions_.end()));
-      tr.unix_time = 2147483647;  // 2038-01-19T03:14:07+00:00
-      tr.type_index = type_index;
-    }
-    return;  // last transition wins
-  }
-
-  // Extend the transitions for an additional 400 years using the
-  // future specification. Years beyond those can be handled by
-  // mapping back to a cycle-equivalent year within that range.
-  // zic(8) should probably do this so that we don't have to.
-  // TODO: Reduce the extension by the number of compatible
-  // transitions already in place.
-  transitions_.reserve(hdr.timecnt + 400 * 2 + 1);
-  transitions_.resize(hdr.timecnt + 400 * 2);
-  extended_ = true;
-
-  // The future specification should match the last two transitions,
-  // and those transitions should have different is_dst flags.  Note
-  // that nothing says the UTC offset used by the is_dst transition
-  // must be greater than that used by the !is_dst transition.  (See
-  // Europe/Dublin, for example.)
-  const Transition* tr0 = &transitions_[hdr.timecnt - 1];
-  const Transition* tr1 = &transitions_[hdr.timecnt - 2];
-  const TransitionType* tt0 = &transition_types_[tr0->type_index];
-  const TransitionType* tt1 = &transition_types_[tr1->type_index];
-  const TransitionType& dst(tt0->is_dst ? *tt0 : *tt1);
-  const TransitionType& std(tt0->is_dst ? *tt1 : *tt0);
-  CheckTransition(name, dst, posix.dst_offset, true, posix.dst_abbr);
-  CheckTransition(name, std, posix.std_offset, false, posix.std_abbr);
-
-  // Add the transitions to tr1 and back to tr0 for each extra year.
-  last_year_ = LocalTime(tr0->unix_time, *tt0).cs.year();
-  bool leap_year = IsLeap(last_year_);
-  const civil_day jan1(last_year_, 1, 1);
-  std::int_fast64_t jan1_time = civil_second(jan1) - civil_second();
-  int jan1_weekday = (static_cast<int>(get_weekday(jan1)) + 1) % 7;
-  Transition* tr = &transitions_[hdr.timecnt];  // next trans to fill
-  if (LocalTime(tr1->unix_time, *tt1).cs.year() != last_year_) {
-    // Add a single extra transition to align to a calendar year.
-    transitions_.resize(transitions_.size() + 1);
-    assert(tr == &transitions_[hdr.timecnt]);  // no reallocation
-    const PosixTransition& pt1(tt0->is_dst ? posix.dst_end : posix.dst_start);
-    std::int_fast64_t tr1_offset = TransOffset(leap_year, jan1_weekday, pt1);
-    tr->unix_time = jan1_time + tr1_offset - tt0->utc_offset;
-    tr++->type_index = tr1->type_index;
-    tr0 = &transitions_[hdr.timecnt];
-    tr1 = &transitions_[hdr.timecnt - 1];
-    tt0 = &transition_types_[tr0->type_index];
-    tt1 = &transition_types_[tr1->type_index];
-  }
-  const PosixTransition& pt1(tt0->is_dst ? posix.dst_end : posix.dst_start);
-  const PosixTransition& pt0(tt0->is_dst ? posix.dst_start : posix.dst_end);
-  for (const year_t limit = last_year_ + 400; last_year_ < limit;) {
-    last_year_ += 1;  // an additional year of generated transitions
-    jan1_time += kSecsPerYear[leap_year];
-    jan1_weekday = (jan1_weekday + kDaysPerYear[leap_year]) % 7;
-    leap_year = !leap_year && IsLeap(last_year_);
-    std::int_fast64_t tr1_offset = TransOffset(leap_year, jan1_weekday, pt1);
-    tr->unix_time = jan1_time + tr1_offset - tt0->utc_offset;
-    tr++->type_index = tr1->type_index;
-    std::int_fast64_t tr0_offset = TransOffset(leap_year, jan1_weekday, pt0);
-    tr->unix_time = jan1_time + tr0_offset - tt1->utc_offset;
-    tr++->type_index = tr0->type_index;
-  }
-  assert(tr == &transitions_[0] + transitions_.size());
+  if (extending) {
+    // The future specification should match the last two transitions,
+    // and those transitions should have different is_dst flags.  Note
+    // that nothing says the UTC offset used by the is_dst transition
+    // must be greater than that used by the !is_dst transition.  (See
+    // Europe/Dublin, for example.)
+    std::size_t tr0 = hdr.timecnt - 1;
+    std::size_t tr1 = hdr.timecnt - 2;
+    const TransitionType* tt0 = &types[trans->type_index[tr0]];
+    const TransitionType* tt1 = &types[trans->type_index[tr1]];
+    {
+      const TransitionType& dst(tt0->is_dst ? *tt0 : *tt1);
+      const TransitionType& std(tt0->is_dst ? *tt1 : *tt0);
+      CheckTransition(name, dst, posix.dst_offset, true, posix.dst_abbr);
+      CheckTransition(name, std, posix.std_offset, false, posix.std_abbr);
+    }
+
+    // Align the stored transitions to a calendar-year boundary so that
+    // the year of the final transition (last_year_) retains its full
+    // rule pair, and so that EvalFutureYear() then owns every later
+    // year. The rule transitions for those years are evaluated on
+    // demand (see BreakTimeFuture() and MakeTimeFuture()) rather than
+    // pregenerated, so memory and load time scale with the zic data
+    // rather than with a multi-century horizon.
+    last_year_ = LocalTime(trans->unix_time[tr0], *tt0).cs.year();
+    const bool leap_year = IsLeap(last_year_);
+    const civil_day jan1(last_year_, 1, 1);
+    const std::int_fast64_t jan1_time = civil_second(jan1) - civil_second();
+    const int jan1_weekday = (static_cast<int>(get_weekday(jan1)) + 1) % 7;
+    if (LocalTime(trans->unix_time[tr1], *tt1).cs.year() != last_year_) {
+      // Add a single extra transition to align to a calendar year.
+      const PosixTransition& pt1(tt0->is_dst ? posix.dst_end : posix.dst_start);
+      const std::int_fast64_t tr1_offset =
+          TransOffset(leap_year, jan1_weekday, pt1);
+      trans->resize(trans->size() + 1);
+      trans->unix_time.back() = jan1_time + tr1_offset - tt0->utc_offset;
+      trans->type_index.back() = trans->type_index[tr1];
+      tr0 = hdr.timecnt;
+      tr1 = hdr.timecnt - 1;
+    }
+    future_types_[0] = trans->type_index[tr1];  // first within a year
+    future_types_[1] = trans->type_index[tr0];  // second (year boundary)
+
+    // Check that the rules yield ordered transitions over a full
+    // 400-year calendar cycle (which visits every leap-year/weekday
+    // combination), as loading the pregenerated extension used to.
+    const TransitionType& ftt1 = types[future_types_[0]];
+    const TransitionType& ftt0 = types[future_types_[1]];
+    const PosixTransition& pt1(ftt0.is_dst ? posix.dst_end : posix.dst_start);
+    const PosixTransition& pt0(ftt0.is_dst ? posix.dst_start : posix.dst_end);
+    std::int_fast64_t prev_civil =
+        trans->unix_time[trans->size() - 1] + ftt0.utc_offset;
+    std::int_fast64_t jan1_sec = jan1_time;
+    int jan1_wday = jan1_weekday;
+    bool leap = leap_year;
+    for (year_t year = last_year_, limit = last_year_ + 400; year < limit;) {
+      year += 1;
+      jan1_sec += kSecsPerYear[leap];
+      jan1_wday = (jan1_wday + kDaysPerYear[leap]) % 7;
+      leap = !leap && IsLeap(year);
+      const std::int_fast64_t civil1 = jan1_sec +
+                                       TransOffset(leap, jan1_wday, pt1) -
+                                       ftt0.utc_offset + ftt1.utc_offset;
+      const std::int_fast64_t civil0 = jan1_sec +
+                                       TransOffset(leap, jan1_wday, pt0) -
+                                       ftt1.utc_offset + ftt0.utc_offset;
+      if (!(prev_civil < civil1) || !(civil1 < civil0)) {
+        std::clog << name << ": Unordered future transitions\n";
+        extending = false;
+        break;
+      }
+      prev_civil = civil0;
+    }
+
+    if (extending) {
+      posix_ = posix;
+      extended_ = true;
+      return;
+    }
+  }
+
+  // Ensure that there is always a transition in the second half of the
+  // time line (the BIG_BANG transition is in the first half) so that the
+  // signed difference between a civil_second and the civil_second of its
+  // previous transition is always representable, without overflow.
+  const std::size_t last = trans->size() - 1;
+  if (trans->unix_time[last] < 0) {
+    const std::uint_least8_t type_index = trans->type_index[last];
+    trans->resize(trans->size() + 1);
+    trans->unix_time.back() = 2147483647;  // 2038-01-19T03:14:07+00:00
+    trans->type_index.back() = type_index;
+  }
+  // last transition wins
 }
 
 bool TimeZoneInfo::Load(const std::string& name, ZoneInfoSource* zip) {
@@ -428,46 +637,53 @@ bool TimeZoneInfo::Load(const std::string& name, ZoneInfoSource* zip) {
   if (hdr.ttisutcnt != 0 && hdr.ttisutcnt != hdr.typecnt)
     return false;
 
-  // Read the data into a local buffer.
+  // Obtain the data, preferably borrowed directly from the source (e.g.,
+  // an mmap'd zoneinfo file), otherwise read into a local buffer.
   std::size_t len = hdr.DataLength(time_len);
-  std::vector<char> tbuf(len);
-  if (zip->Read(tbuf.data(), len) != len)
-    return false;
-  const char* bp = tbuf.data();
+  std::vector<char> tbuf;
+  const char* bp = zip->BorrowBytes(len);
+  if (bp == nullptr) {
+    tbuf.resize(len);
+    if (zip->Read(tbuf.data(), len) != len)
+      return false;
+    bp = tbuf.data();
+  }
+  const char* const bp_begin = bp;
 
-  // Decode and validate the transitions.
-  transitions_.reserve(hdr.timecnt + 2);  // We might add a couple.
-  transitions_.resize(hdr.timecnt);
+  // Decode and validate the transitions, into load-time scratch that
+  // CommitToArena() will pack into the zone's single allocation.
+  Transitions trans;
+  trans.reserve(hdr.timecnt + 2);  // We might add a couple.
+  trans.resize(hdr.timecnt);
   for (std::size_t i = 0; i != hdr.timecnt; ++i) {
-    transitions_[i].unix_time = (time_len == 4) ? Decode32(bp) : Decode64(bp);
+    trans.unix_time[i] = (time_len == 4) ? Decode32(bp) : Decode64(bp);
     bp += time_len;
     if (i != 0) {
       // Check that the transitions are ordered by time (as zic guarantees).
-      if (!Transition::ByUnixTime()(transitions_[i - 1], transitions_[i]))
+      if (!(trans.unix_time[i - 1] < trans.unix_time[i]))
         return false;  // out of order
     }
   }
   bool seen_type_0 = false;
   for (std::size_t i = 0; i != hdr.timecnt; ++i) {
-    transitions_[i].type_index = Decode8(bp++);
-    if (transitions_[i].type_index >= hdr.typecnt)
+    trans.type_index[i] = Decode8(bp++);
+    if (trans.type_index[i] >= hdr.typecnt)
       return false;
-    if (transitions_[i].type_index == 0)
+    if (trans.type_index[i] == 0)
       seen_type_0 = true;
   }
 
   // Decode and validate the transition types.
-  transition_types_.resize(hdr.typecnt);
+  std::vector<TransitionType> types(hdr.typecnt);
   for (std::size_t i = 0; i != hdr.typecnt; ++i) {
-    transition_types_[i].utc_offset =
-        static_cast<std::int_least32_t>(Decode32(bp));
-    if (transition_types_[i].utc_offset >= kSecsPerDay ||
-        transition_types_[i].utc_offset <= -kSecsPerDay)
+    types[i].utc_offset = static_cast<std::int_least32_t>(Decode32(bp));
+    if (types[i].utc_offset >= kSecsPerDay ||
+        types[i].utc_offset <= -kSecsPerDay)
       return false;
     bp += 4;
-    transition_types_[i].is_dst = (Decode8(bp++) != 0);
-    transition_types_[i].abbr_index = Decode8(bp++);
-    if (transition_types_[i].abbr_index >= hdr.charcnt)
+    types[i].is_dst = (Decode8(bp++) != 0);
+    types[i].abbr_index = Decode8(bp++);
+    if (types[i].abbr_index >= hdr.charcnt)
       return false;
   }
 
@@ -475,19 +691,22 @@ bool TimeZoneInfo::Load(const std::string& name, ZoneInfoSource* zip) {
   default_transition_type_ = 0;
   if (seen_type_0 && hdr.timecnt != 0) {
     std::uint_fast8_t index = 0;
-    if (transition_types_[0].is_dst) {
-      index = transitions_[0].type_index;
-      while (index != 0 && transition_types_[index].is_dst)
+    if (types[0].is_dst) {
+      index = trans.type_index[0];
+      while (index != 0 && types[index].is_dst)
         --index;
     }
-    while (index != hdr.typecnt && transition_types_[index].is_dst)
+    while (index != hdr.typecnt && types[index].is_dst)
       ++index;
     if (index != hdr.typecnt)
       default_transition_type_ = index;
   }
 
-  // Copy all the abbreviations.
-  abbreviations_.assign(bp, hdr.charcnt);
+  // Copy all the abbreviations. Temporarily view the scratch copy so
+  // that LocalTime() and CheckTransition() work while building;
+  // CommitToArena() repoints the view into the arena.
+  std::string abbrs(bp, hdr.charcnt);
+  abbreviations_ = ArenaSpan<char>(abbrs.data(), abbrs.size());
   bp += hdr.charcnt;
 
   // Skip the unused portions. We've already dispensed with leap-second
@@ -497,7 +716,8 @@ bool TimeZoneInfo::Load(const std::string& name, ZoneInfoSource* zip) {
   bp += (8 + 4) * hdr.leapcnt;  // leap-time + TAI-UTC
   bp += 1 * hdr.ttisstdcnt;     // UTC/local indicators
   bp += 1 * hdr.ttisutcnt;      // standard/wall indicators
-  assert(bp == tbuf.data() + tbuf.size());
+  assert(bp == bp_begin + len);
+  (void)bp_begin;
 
   future_spec_.clear();
   if (tzh.tzh_version[0] != '\0') {
@@ -530,59 +750,706 @@ bool TimeZoneInfo::Load(const std::string& name, ZoneInfoSource* zip) {
   // zic.c:dontmerge) and the Qt library (see zic.c:WORK_AROUND_QTBUG_53071).
   // For us, they just get in the way when we do future_spec_ extension.
   while (hdr.timecnt > 1) {
-    if (!EquivTransitions(transitions_[hdr.timecnt - 1].type_index,
-                          transitions_[hdr.timecnt - 2].type_index)) {
+    if (!EquivTransitions(types[trans.type_index[hdr.timecnt - 1]],
+                          types[trans.type_index[hdr.timecnt - 2]])) {
       break;
     }
     hdr.timecnt -= 1;
   }
-  transitions_.resize(hdr.timecnt);
+  trans.resize(hdr.timecnt);
 
   // Ensure that there is always a transition in the first half of the
   // time line (the second half is handled in ExtendTransitions()) so that
   // the signed difference between a civil_second and the civil_second of
   // its previous transition is always representable, without overflow.
   // A contemporary zic will usually have already done this for us.
-  if (transitions_.empty() || transitions_.front().unix_time >= 0) {
-    Transition& tr(*transitions_.emplace(transitions_.begin()));
-    tr.unix_time = -(1LL << 59);  // see tz/zic.c "BIG_BANG"
-    tr.type_index = default_transition_type_;
+  if (trans.empty() || trans.unix_time.front() >= 0) {
+    // see tz/zic.c "BIG_BANG"
+    trans.push_front(-(1LL << 59), default_transition_type_);
     hdr.timecnt += 1;
   }
 
   // Extend the transitions using the future specification.
-  ExtendTransitions(name, hdr);
+  ExtendTransitions(name, hdr, types, &trans);
 
   // Compute the local civil time for each transition and the preceding
   // second. These will be used for reverse conversions in MakeTime().
-  const TransitionType* ttp = &transition_types_[default_transition_type_];
-  for (std::size_t i = 0; i != transitions_.size(); ++i) {
-    Transition& tr(transitions_[i]);
-    tr.prev_civil_sec = LocalTime(tr.unix_time, *ttp).cs - 1;
-    ttp = &transition_types_[tr.type_index];
-    tr.civil_sec = LocalTime(tr.unix_time, *ttp).cs;
+  const TransitionType* ttp = &types[default_transition_type_];
+  for (std::size_t i = 0; i != trans.size(); ++i) {
+    const std::int_fast64_t unix_time = trans.unix_time[i];
+    trans.prev_civil_sec[i] = LocalTime(unix_time, *ttp).cs - 1;
+    ttp = &types[trans.type_index[i]];
+    trans.civil_sec[i] = LocalTime(unix_time, *ttp).cs;
     if (i != 0) {
       // Check that the transitions are ordered by civil time. Essentially
       // this means that an offset change cannot cross another such change.
       // No one does this in practice, and we depend on it in MakeTime().
-      if (!Transition::ByCivilTime()(transitions_[i - 1], tr))
+      if (!(trans.civil_sec[i - 1] < trans.civil_sec[i]))
         return false;  // out of order
     }
   }
 
   // Compute the maximum/minimum civil times that can be converted to a
   // time_point<seconds> for each of the zone's transition types.
-  for (auto& tt : transition_types_) {
+  for (auto& tt : types) {
     tt.civil_max = LocalTime(seconds::max().count(), tt).cs;
     tt.civil_min = LocalTime(seconds::min().count(), tt).cs;
   }
 
-  transitions_.shrink_to_fit();
+  CommitToArena(trans, types, abbrs);
+  return true;
+}
+
+namespace {
+
+// The width of a unix-time search bucket, as a power of two. 2^25
+// seconds is a bit over a year, so a bucket normally spans only the
+// handful of transitions that occur within a year.
+const int kTimeIndexShift = 25;
+
+// An upper bound on the size of a search index. A pathological zone
+// whose transitions span more buckets than this gets no index (and so
+// falls back to binary search) rather than a huge allocation.
+const std::size_t kMaxIndexSize = 1 << 20;
+
+}  // namespace
+
+// Builds the flat bucket indexes over the (now final) transitions that
+// make a hint-miss search in BreakTime()/MakeTime() one array load plus
+// a scan of at most a few entries, rather than a binary search over the
+// hundreds of entries generated by ExtendTransitions(). The buckets are
+// based at the second transition because the first may be the distant
+// BIG_BANG sentinel; queries before the base simply scan forward from
+// index 0, crossing at most that one sentinel entry. Entries are capped
+// at timecnt - 2 so that the "key i + 1" scans they seed stay in
+// bounds, which is also what LoadFromArenaImage() demands of an image.
+void TimeZoneInfo::BuildSearchIndex(
+    const Transitions& trans, std::vector<std::uint_least32_t>* time_index,
+    std::vector<std::uint_least32_t>* year_index) {
+  const std::size_t timecnt = trans.size();
+  if (timecnt < 2) return;  // searches are trivial
+
+  time_index_base_ = trans.unix_time[1];
+  const std::int_fast64_t time_span =
+      trans.unix_time[timecnt - 1] - time_index_base_;
+  const std::size_t time_buckets =
+      static_cast<std::size_t>(time_span >> kTimeIndexShift) + 1;
+  if (time_buckets <= kMaxIndexSize) {
+    time_index->reserve(time_buckets);
+    std::size_t i = 0;
+    for (std::size_t b = 0; b != time_buckets; ++b) {
+      const std::int_fast64_t start =
+          time_index_base_ +
+          (static_cast<std::int_fast64_t>(b) << kTimeIndexShift);
+      while (i + 2 != timecnt && trans.unix_time[i + 1] <= start) ++i;
+      time_index->push_back(static_cast<std::uint_least32_t>(i));
+    }
+  }
+
+  year_index_base_ = trans.civil_sec[1].year();
+  const year_t year_span =
+      trans.civil_sec[timecnt - 1].year() - year_index_base_;
+  if (year_span >= 0 &&
+      static_cast<std::size_t>(year_span) < kMaxIndexSize) {
+    const std::size_t year_buckets = static_cast<std::size_t>(year_span) + 1;
+    year_index->reserve(year_buckets);
+    std::size_t i = 0;
+    for (std::size_t b = 0; b != year_buckets; ++b) {
+      const civil_second start(year_index_base_ + static_cast<year_t>(b),
+                               1, 1, 0, 0, 0);
+      while (i + 2 != timecnt && trans.civil_sec[i + 1] <= start) ++i;
+      year_index->push_back(static_cast<std::uint_least32_t>(i));
+    }
+  }
+}
+
+// Packs the final form of the zone's data into a single allocation.
+// The scratch containers passed in (and those built by
+// BuildSearchIndex()) are copied into one right-sized block, most
+// strictly aligned arrays first so that every array is naturally
+// aligned, and the member views are pointed at their placements.
+void TimeZoneInfo::CommitToArena(const Transitions& trans,
+                                 const std::vector<TransitionType>& types,
+                                 const std::string& abbrs) {
+  static_assert(std::is_trivially_copyable<civil_second>::value,
+                "civil_second is memcpy'd into the arena");
+  static_assert(std::is_trivially_copyable<TransitionType>::value,
+                "TransitionType is memcpy'd into the arena");
+
+  std::vector<std::uint_least32_t> time_index;
+  std::vector<std::uint_least32_t> year_index;
+  BuildSearchIndex(trans, &time_index, &year_index);
+
+  const std::size_t timecnt = trans.size();
+  std::size_t len = 0;
+  const std::size_t unix_time_pos = len;
+  len += timecnt * sizeof(std::int_least64_t);
+#if !defined(CCTZ_COMPACT_TRANSITIONS)
+  // In compact mode the civil times are not stored; they are derived on
+  // demand from unix_time and the transition types (see CivilSecAt()).
+  const std::size_t civil_sec_pos = len;
+  len += timecnt * sizeof(civil_second);
+  const std::size_t prev_civil_sec_pos = len;
+  len += timecnt * sizeof(civil_second);
+#endif
+  const std::size_t types_pos = len;
+  len += types.size() * sizeof(TransitionType);
+  const std::size_t time_index_pos = len;
+  len += time_index.size() * sizeof(std::uint_least32_t);
+  const std::size_t year_index_pos = len;
+  len += year_index.size() * sizeof(std::uint_least32_t);
+  const std::size_t type_index_pos = len;
+  len += timecnt * sizeof(std::uint_least8_t);
+  const std::size_t abbrs_pos = len;
+  len += abbrs.size();
+
+  arena_.reset(new char[len]);
+  char* const base = arena_.get();
+  arena_base_ = base;
+  arena_len_ = len;
+  const auto place = [base](std::size_t pos, const void* src, std::size_t n) {
+    if (n != 0) std::memcpy(base + pos, src, n);
+  };
+  place(unix_time_pos, trans.unix_time.data(),
+        timecnt * sizeof(std::int_least64_t));
+#if !defined(CCTZ_COMPACT_TRANSITIONS)
+  place(civil_sec_pos, trans.civil_sec.data(),
+        timecnt * sizeof(civil_second));
+  place(prev_civil_sec_pos, trans.prev_civil_sec.data(),
+        timecnt * sizeof(civil_second));
+#endif
+  place(types_pos, types.data(), types.size() * sizeof(TransitionType));
+  place(time_index_pos, time_index.data(),
+        time_index.size() * sizeof(std::uint_least32_t));
+  place(year_index_pos, year_index.data(),
+        year_index.size() * sizeof(std::uint_least32_t));
+  place(type_index_pos, trans.type_index.data(),
+        timecnt * sizeof(std::uint_least8_t));
+  place(abbrs_pos, abbrs.data(), abbrs.size());
+
+  transitions_.unix_time = ArenaSpan<std::int_least64_t>(
+      reinterpret_cast<const std::int_least64_t*>(base + unix_time_pos),
+      timecnt);
+#if !defined(CCTZ_COMPACT_TRANSITIONS)
+  transitions_.civil_sec = ArenaSpan<civil_second>(
+      reinterpret_cast<const civil_second*>(base + civil_sec_pos), timecnt);
+  transitions_.prev_civil_sec = ArenaSpan<civil_second>(
+      reinterpret_cast<const civil_second*>(base + prev_civil_sec_pos),
+      timecnt);
+#endif
+  transitions_.type_index = ArenaSpan<std::uint_least8_t>(
+      reinterpret_cast<const std::uint_least8_t*>(base + type_index_pos),
+      timecnt);
+  transition_types_ = ArenaSpan<TransitionType>(
+      reinterpret_cast<const TransitionType*>(base + types_pos),
+      types.size());
+  time_index_ = ArenaSpan<std::uint_least32_t>(
+      reinterpret_cast<const std::uint_least32_t*>(base + time_index_pos),
+      time_index.size());
+  year_index_ = ArenaSpan<std::uint_least32_t>(
+      reinterpret_cast<const std::uint_least32_t*>(base + year_index_pos),
+      year_index.size());
+  abbreviations_ = ArenaSpan<char>(base + abbrs_pos, abbrs.size());
+
+  // Classify zones that have settled into a single fixed offset (e.g.,
+  // Asia/Tokyo since 1951), so that lookups of instants within the
+  // final regime can skip the transition search entirely. The regime
+  // begins at the earliest transition whose type, and that of every
+  // later transition, is equivalent to the last one's.
+  steady_ = !extended_ && timecnt != 0;
+  if (steady_) {
+    const std::size_t last = timecnt - 1;
+    const TransitionType& last_tt = transition_types_[
+        transitions_.type_index[last]];
+    std::size_t s = last;
+    while (s != 0 &&
+           EquivTransitions(transition_types_[transitions_.type_index[s - 1]],
+                            last_tt)) {
+      --s;
+    }
+    steady_since_unix_ = transitions_.unix_time[s];
+    // The first civil time that unambiguously belongs to the regime:
+    // past the fold when transition s was a fall-back, and at the first
+    // valid civil time when it was a spring-forward.
+    steady_min_civil_ = std::max(CivilSecAt(s), PrevCivilSecAt(s) + 1);
+  }
+}
+
+#if defined(CCTZ_ENABLE_STATS)
+namespace {
+
+// The number of probes a binary search over n keys makes, for the
+// search_steps counter when the bucket indexes are unbuildable.
+std::uint_least64_t Log2Floor(std::size_t n) {
+  std::uint_least64_t r = 0;
+  while (n >>= 1) ++r;
+  return r;
+}
+
+}  // namespace
+#endif
+
+// Returns the index of the first transition strictly after the given
+// unix time, like std::upper_bound() over transitions_.unix_time.
+// Requires transitions_.unix_time[0] <= unix_time and
+// unix_time < transitions_.unix_time.back().
+std::size_t TimeZoneInfo::UpperBoundUnix(std::int_fast64_t unix_time) const {
+  const ArenaSpan<std::int_least64_t>& keys = transitions_.unix_time;
+  if (time_index_.empty()) {  // unindexed; fall back to binary search
+    CCTZ_STATS_ADD(counters_.search_steps, Log2Floor(keys.size()) + 1);
+    return static_cast<std::size_t>(
+        std::upper_bound(keys.begin(), keys.end(), unix_time) - keys.begin());
+  }
+  std::size_t i = 0;
+  if (unix_time >= time_index_base_) {
+    std::size_t b = static_cast<std::size_t>(
+        (unix_time - time_index_base_) >> kTimeIndexShift);
+    if (b >= time_index_.size()) b = time_index_.size() - 1;
+    i = time_index_[b];
+  }
+#if defined(CCTZ_ENABLE_STATS)
+  const std::size_t scan_start = i;
+#endif
+  while (keys[i + 1] <= unix_time) ++i;
+  CCTZ_STATS_ADD(counters_.search_steps, i - scan_start + 1);
+  return i + 1;
+}
+
+// Returns the index of the first transition whose civil time is
+// strictly after the given civil time, like std::upper_bound() over
+// the transitions' civil times. Requires CivilSecAt(0) <= cs and
+// cs < CivilSecAt(transitions_.size() - 1).
+std::size_t TimeZoneInfo::UpperBoundCivil(const civil_second& cs) const {
+  if (year_index_.empty()) {  // unindexed; fall back to binary search
+    CCTZ_STATS_ADD(counters_.search_steps,
+                   Log2Floor(transitions_.size()) + 1);
+    std::size_t lo = 0;
+    std::size_t hi = transitions_.size();
+    while (lo != hi) {
+      const std::size_t mid = lo + (hi - lo) / 2;
+      if (CivilSecAt(mid) <= cs) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+  std::size_t i = 0;
+  if (cs.year() >= year_index_base_) {
+    std::size_t b = static_cast<std::size_t>(cs.year() - year_index_base_);
+    if (b >= year_index_.size()) b = year_index_.size() - 1;
+    i = year_index_[b];
+  }
+#if defined(CCTZ_ENABLE_STATS)
+  const std::size_t scan_start = i;
+#endif
+  while (CivilSecAt(i + 1) <= cs) ++i;
+  CCTZ_STATS_ADD(counters_.search_steps, i - scan_start + 1);
+  return i + 1;
+}
+
+bool TimeZoneInfo::SerializeCompiledCache(std::string* out) const {
+  // The counts are bounded by the TZif format, but check anyway so the
+  // loader can trust the 32-bit fields.
+  if (transitions_.size() > 0x7fffffff) return false;
+  if (transition_types_.size() > 0xff) return false;
+  if (abbreviations_.size() > 0xff) return false;
+  if (future_spec_.size() > 0x7fffffff) return false;
+  if (version_.size() > 0x7fffffff) return false;
+
+  out->clear();
+  out->reserve(kCompiledCacheMagicLen + 5 * 4 + 2 + 8 +
+               transition_types_.size() * kEncodedTypeLen +
+               transitions_.size() * kEncodedTransitionLen +
+               abbreviations_.size() + future_spec_.size() + version_.size());
+  out->append(kCompiledCacheMagic, kCompiledCacheMagicLen);
+  Encode32(out, static_cast<std::int_fast32_t>(transitions_.size()));
+  Encode32(out, static_cast<std::int_fast32_t>(transition_types_.size()));
+  Encode32(out, static_cast<std::int_fast32_t>(abbreviations_.size()));
+  Encode32(out, static_cast<std::int_fast32_t>(future_spec_.size()));
+  Encode32(out, static_cast<std::int_fast32_t>(version_.size()));
+  Encode8(out, default_transition_type_);
+  Encode8(out, extended_ ? 1 : 0);
+  Encode64(out, extended_ ? last_year_ : 0);
+  for (const TransitionType& tt : transition_types_) {
+    Encode32(out, tt.utc_offset);
+    Encode8(out, tt.is_dst ? 1 : 0);
+    Encode8(out, tt.abbr_index);
+    EncodeCivil(out, tt.civil_max);
+    EncodeCivil(out, tt.civil_min);
+  }
+  for (std::size_t i = 0; i != transitions_.size(); ++i) {
+    Encode64(out, transitions_.unix_time[i]);
+    Encode8(out, transitions_.type_index[i]);
+    EncodeCivil(out, CivilSecAt(i));
+    EncodeCivil(out, PrevCivilSecAt(i));
+  }
+  out->append(abbreviations_.begin(), abbreviations_.size());
+  out->append(future_spec_);
+  out->append(version_);
+  return true;
+}
+
+bool TimeZoneInfo::LoadFromCompiledCache(const char* data, std::size_t len) {
+  const char* bp = data;
+  if (len < kCompiledCacheMagicLen + 5 * 4 + 2 + 8) return false;
+  if (memcmp(bp, kCompiledCacheMagic, kCompiledCacheMagicLen) != 0)
+    return false;
+  bp += kCompiledCacheMagicLen;
+  const std::int_fast32_t timecnt = Decode32(bp);
+  const std::int_fast32_t typecnt = Decode32(bp + 4);
+  const std::int_fast32_t charcnt = Decode32(bp + 8);
+  const std::int_fast32_t speclen = Decode32(bp + 12);
+  const std::int_fast32_t verslen = Decode32(bp + 16);
+  bp += 5 * 4;
+  if (timecnt < 1 || typecnt < 1 || typecnt > 0xff || charcnt < 0 ||
+      charcnt > 0xff || speclen < 0 || verslen < 0) {
+    return false;
+  }
+  const std::size_t want =
+      kCompiledCacheMagicLen + 5 * 4 + 2 + 8 +
+      static_cast<std::size_t>(typecnt) * kEncodedTypeLen +
+      static_cast<std::size_t>(timecnt) * kEncodedTransitionLen +
+      static_cast<std::size_t>(charcnt) + static_cast<std::size_t>(speclen) +
+      static_cast<std::size_t>(verslen);
+  if (len != want) return false;
+  default_transition_type_ = Decode8(bp);
+  extended_ = (Decode8(bp + 1) != 0);
+  last_year_ = Decode64(bp + 2);
+  bp += 2 + 8;
+  if (default_transition_type_ >= typecnt) return false;
+
+  std::vector<TransitionType> types(static_cast<std::size_t>(typecnt));
+  for (TransitionType& tt : types) {
+    tt.utc_offset = static_cast<std::int_least32_t>(Decode32(bp));
+    tt.is_dst = (Decode8(bp + 4) != 0);
+    tt.abbr_index = Decode8(bp + 5);
+    if (tt.abbr_index >= charcnt) return false;
+    tt.civil_max = DecodeCivil(bp + 6);
+    tt.civil_min = DecodeCivil(bp + 6 + kEncodedCivilLen);
+    bp += kEncodedTypeLen;
+  }
+  Transitions trans;
+  trans.resize(static_cast<std::size_t>(timecnt));
+  for (std::size_t i = 0; i != trans.size(); ++i) {
+    trans.unix_time[i] = Decode64(bp);
+    trans.type_index[i] = Decode8(bp + 8);
+    if (trans.type_index[i] >= typecnt) return false;
+    trans.civil_sec[i] = DecodeCivil(bp + 9);
+    trans.prev_civil_sec[i] = DecodeCivil(bp + 9 + kEncodedCivilLen);
+    bp += kEncodedTransitionLen;
+    if (i != 0) {
+      // Check that the transitions are ordered by both time and civil
+      // time, as the serializer guarantees and the search code depends
+      // upon. A damaged record must fail here, not produce misordered
+      // indexes through CommitToArena().
+      if (!(trans.unix_time[i - 1] < trans.unix_time[i]) ||
+          !(trans.civil_sec[i - 1] < trans.civil_sec[i])) {
+        return false;  // out of order
+      }
+    }
+  }
+  const std::string abbrs(bp, static_cast<std::size_t>(charcnt));
+  bp += charcnt;
+  future_spec_.assign(bp, static_cast<std::size_t>(speclen));
+  bp += speclen;
+  version_.assign(bp, static_cast<std::size_t>(verslen));
+  if (extended_) {
+    // Reconstruct the on-demand rule-evaluation state from the spec
+    // and the (calendar-year aligned) tail of the transitions.
+    if (!ParsePosixSpec(future_spec_, &posix_)) return false;
+    if (trans.size() < 2) return false;
+    future_types_[0] = trans.type_index[trans.size() - 2];
+    future_types_[1] = trans.type_index[trans.size() - 1];
+  }
+  CommitToArena(trans, types, abbrs);
   return true;
 }
 
 namespace {
 
+// The layout of a shared-arena image (see SerializeArenaImage()): a
+// fixed native-endian header, zero padding to a 64-byte boundary, the
+// raw arena bytes exactly as CommitToArena() placed them, then the
+// future-spec and version strings. Unlike the compiled-cache records
+// above, which are decoded into a private heap copy, an image is the
+// in-memory form itself, so a loader maps the file read-only and
+// shared and points its views into the mapping. The format is only
+// meaningful between identical builds on one host; ImageAbiTag()
+// rejects everything else.
+const char kArenaImageMagic[] = "tzarena1";
+const std::size_t kArenaImageMagicLen = sizeof(kArenaImageMagic) - 1;
+const std::size_t kArenaImageAlign = 64;
+
+struct ArenaImageHeader {
+  char magic[8];                  // kArenaImageMagic
+  std::uint_least64_t abi;        // ImageAbiTag() of the producer
+  std::uint_least64_t arena_len;  // bytes of arena payload
+  std::uint_least64_t timecnt;
+  std::uint_least64_t typecnt;
+  std::uint_least64_t charcnt;
+  std::uint_least64_t time_index_cnt;
+  std::uint_least64_t year_index_cnt;
+  std::uint_least64_t unix_time_pos;  // array offsets within the arena
+  std::uint_least64_t civil_sec_pos;
+  std::uint_least64_t prev_civil_sec_pos;
+  std::uint_least64_t types_pos;
+  std::uint_least64_t time_index_pos;
+  std::uint_least64_t year_index_pos;
+  std::uint_least64_t type_index_pos;
+  std::uint_least64_t abbrs_pos;
+  std::int_least64_t time_index_base;
+  std::int_least64_t year_index_base;
+  std::int_least64_t last_year;
+  std::int_least64_t steady_since_unix;
+  civil_second steady_min_civil;
+  std::uint_least32_t speclen;
+  std::uint_least32_t verslen;
+  std::uint_least8_t default_type;
+  std::uint_least8_t extended;
+  std::uint_least8_t steady;
+  std::uint_least8_t future_types[2];
+};
+static_assert(sizeof(ArenaImageHeader) <= 4 * kArenaImageAlign,
+              "unexpected ArenaImageHeader size");
+
+// The offset of the arena payload within an image.
+const std::size_t kArenaImagePayload =
+    (sizeof(ArenaImageHeader) + kArenaImageAlign - 1) &
+    ~(kArenaImageAlign - 1);
+
+// A fingerprint of everything that determines the in-memory layout:
+// the image-format revision, the compact-transitions mode, the sizes
+// and alignment of the arena element types, and the byte order.
+std::uint_fast64_t ImageAbiTag() {
+  const std::uint_least32_t probe = 1;
+  unsigned char lsb = 0;
+  std::memcpy(&lsb, &probe, 1);
+  std::uint_fast64_t tag = 1;  // format revision
+#if defined(CCTZ_COMPACT_TRANSITIONS)
+  tag = (tag << 1) | 1;
+#else
+  tag = tag << 1;
+#endif
+  tag = (tag << 8) | sizeof(civil_second);
+  tag = (tag << 8) | sizeof(TransitionType);
+  tag = (tag << 8) | alignof(TransitionType);
+  tag = (tag << 8) | (sizeof(ArenaImageHeader) & 0xff);
+  tag = (tag << 8) | lsb;
+  return tag;
+}
+
+}  // namespace
+
+TimeZoneInfo::~TimeZoneInfo() {
+#if defined(CCTZ_HAS_MMAP)
+  if (mapped_image_ != nullptr) {
+    munmap(const_cast<char*>(mapped_image_), mapped_image_len_);
+  }
+#endif
+}
+
+bool TimeZoneInfo::SerializeArenaImage(std::string* out) const {
+  const char* const base = arena_base_;
+  if (base == nullptr) return false;
+  if (future_spec_.size() > 0xffffffff) return false;
+  if (version_.size() > 0xffffffff) return false;
+
+  // An array's offset within the arena, with empty views (e.g., an
+  // unbuildable index, or the civil arrays in compact mode) at zero.
+  const auto pos = [base](const void* p, std::size_t n) {
+    return static_cast<std::uint_least64_t>(
+        (n == 0) ? 0 : static_cast<const char*>(p) - base);
+  };
+
+  ArenaImageHeader hdr{};
+  std::memcpy(hdr.magic, kArenaImageMagic, kArenaImageMagicLen);
+  hdr.abi = ImageAbiTag();
+  hdr.arena_len = arena_len_;
+  hdr.timecnt = transitions_.size();
+  hdr.typecnt = transition_types_.size();
+  hdr.charcnt = abbreviations_.size();
+  hdr.time_index_cnt = time_index_.size();
+  hdr.year_index_cnt = year_index_.size();
+  hdr.unix_time_pos =
+      pos(transitions_.unix_time.begin(), transitions_.unix_time.size());
+  hdr.civil_sec_pos =
+      pos(transitions_.civil_sec.begin(), transitions_.civil_sec.size());
+  hdr.prev_civil_sec_pos = pos(transitions_.prev_civil_sec.begin(),
+                               transitions_.prev_civil_sec.size());
+  hdr.types_pos = pos(transition_types_.begin(), transition_types_.size());
+  hdr.time_index_pos = pos(time_index_.begin(), time_index_.size());
+  hdr.year_index_pos = pos(year_index_.begin(), year_index_.size());
+  hdr.type_index_pos =
+      pos(transitions_.type_index.begin(), transitions_.type_index.size());
+  hdr.abbrs_pos = pos(abbreviations_.begin(), abbreviations_.size());
+  hdr.time_index_base = time_index_base_;
+  hdr.year_index_base = year_index_base_;
+  hdr.last_year = extended_ ? last_year_ : 0;
+  hdr.steady_since_unix = steady_ ? steady_since_unix_ : 0;
+  hdr.steady_min_civil = steady_ ? steady_min_civil_ : civil_second();
+  hdr.speclen = static_cast<std::uint_least32_t>(future_spec_.size());
+  hdr.verslen = static_cast<std::uint_least32_t>(version_.size());
+  hdr.default_type = default_transition_type_;
+  hdr.extended = extended_ ? 1 : 0;
+  hdr.steady = steady_ ? 1 : 0;
+  hdr.future_types[0] = future_types_[0];
+  hdr.future_types[1] = future_types_[1];
+
+  out->clear();
+  out->reserve(kArenaImagePayload + arena_len_ + future_spec_.size() +
+               version_.size());
+  out->append(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+  out->append(kArenaImagePayload - sizeof(hdr), '\0');
+  out->append(base, arena_len_);
+  out->append(future_spec_);
+  out->append(version_);
+  return true;
+}
+
+bool TimeZoneInfo::LoadFromArenaImage(const std::string& path) {
+#if defined(CCTZ_HAS_MMAP)
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat sb;
+  if (fstat(fd, &sb) != 0 ||
+      static_cast<std::size_t>(sb.st_size) < kArenaImagePayload) {
+    close(fd);
+    return false;
+  }
+  const std::size_t len = static_cast<std::size_t>(sb.st_size);
+  void* const map = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);  // the mapping persists without it
+  if (map == MAP_FAILED) return false;
+  const char* const image = static_cast<const char*>(map);
+
+  // Validate the header against this build and the file size, and the
+  // array placements against the arena bounds, before trusting any of
+  // it. Anything amiss means the image is for some other build (or is
+  // damaged) and the caller falls back to the other zone sources.
+  ArenaImageHeader hdr;
+  std::memcpy(&hdr, image, sizeof(hdr));
+  const char* const base = image + kArenaImagePayload;
+  const auto ok_span = [&hdr](std::uint_least64_t pos, std::uint_least64_t n,
+                              std::size_t elem_size, std::size_t align) {
+    return n <= hdr.arena_len && n * elem_size <= hdr.arena_len &&
+           pos <= hdr.arena_len - n * elem_size && pos % align == 0;
+  };
+  const std::uint_least64_t overhead = kArenaImagePayload +
+                                       std::uint_least64_t{hdr.speclen} +
+                                       std::uint_least64_t{hdr.verslen};
+  if (std::memcmp(hdr.magic, kArenaImageMagic, kArenaImageMagicLen) != 0 ||
+      hdr.abi != ImageAbiTag() ||
+      len < overhead || hdr.arena_len != len - overhead ||
+      hdr.timecnt < 1 || hdr.typecnt < 1 || hdr.typecnt > 0x100 ||
+      hdr.charcnt > 0x100 || hdr.default_type >= hdr.typecnt ||
+#if !defined(CCTZ_COMPACT_TRANSITIONS)
+      hdr.civil_sec_pos == 0 || hdr.prev_civil_sec_pos == 0 ||
+#endif
+      !ok_span(hdr.unix_time_pos, hdr.timecnt, sizeof(std::int_least64_t),
+               alignof(std::int_least64_t)) ||
+      !ok_span(hdr.civil_sec_pos, hdr.civil_sec_pos ? hdr.timecnt : 0,
+               sizeof(civil_second), alignof(civil_second)) ||
+      !ok_span(hdr.prev_civil_sec_pos,
+               hdr.prev_civil_sec_pos ? hdr.timecnt : 0, sizeof(civil_second),
+               alignof(civil_second)) ||
+      !ok_span(hdr.types_pos, hdr.typecnt, sizeof(TransitionType),
+               alignof(TransitionType)) ||
+      !ok_span(hdr.time_index_pos, hdr.time_index_cnt,
+               sizeof(std::uint_least32_t), alignof(std::uint_least32_t)) ||
+      !ok_span(hdr.year_index_pos, hdr.year_index_cnt,
+               sizeof(std::uint_least32_t), alignof(std::uint_least32_t)) ||
+      !ok_span(hdr.type_index_pos, hdr.timecnt, 1, 1) ||
+      !ok_span(hdr.abbrs_pos, hdr.charcnt, 1, 1)) {
+    munmap(map, len);
+    return false;
+  }
+  const auto timecnt = static_cast<std::size_t>(hdr.timecnt);
+  const auto typecnt = static_cast<std::size_t>(hdr.typecnt);
+  const auto* type_index = reinterpret_cast<const std::uint_least8_t*>(
+      base + hdr.type_index_pos);
+  const auto* types =
+      reinterpret_cast<const TransitionType*>(base + hdr.types_pos);
+  bool valid = true;
+  for (std::size_t i = 0; valid && i != timecnt; ++i) {
+    valid = type_index[i] < typecnt;
+  }
+  for (std::size_t i = 0; valid && i != typecnt; ++i) {
+    valid = types[i].abbr_index < hdr.charcnt;
+  }
+  // The search indexes hold scan start positions, and the scans in
+  // UpperBoundUnix()/UpperBoundCivil() step from entry i to key i + 1,
+  // so any entry beyond timecnt - 2 would read past the arena.
+  const auto* time_index = reinterpret_cast<const std::uint_least32_t*>(
+      base + hdr.time_index_pos);
+  const auto* year_index = reinterpret_cast<const std::uint_least32_t*>(
+      base + hdr.year_index_pos);
+  for (std::size_t i = 0;
+       valid && i != static_cast<std::size_t>(hdr.time_index_cnt); ++i) {
+    valid = time_index[i] < timecnt - 1;
+  }
+  for (std::size_t i = 0;
+       valid && i != static_cast<std::size_t>(hdr.year_index_cnt); ++i) {
+    valid = year_index[i] < timecnt - 1;
+  }
+  if (valid && hdr.extended != 0) {
+    future_spec_.assign(base + hdr.arena_len,
+                        static_cast<std::size_t>(hdr.speclen));
+    valid = timecnt >= 2 && hdr.future_types[0] < typecnt &&
+            hdr.future_types[1] < typecnt && ParsePosixSpec(future_spec_, &posix_);
+  }
+  if (!valid) {
+    munmap(map, len);
+    return false;
+  }
+
+  mapped_image_ = image;
+  mapped_image_len_ = len;
+  arena_base_ = base;
+  arena_len_ = static_cast<std::size_t>(hdr.arena_len);
+  transitions_.unix_time = ArenaSpan<std::int_least64_t>(
+      reinterpret_cast<const std::int_least64_t*>(base + hdr.unix_time_pos),
+      timecnt);
+  transitions_.civil_sec = ArenaSpan<civil_second>(
+      reinterpret_cast<const civil_second*>(base + hdr.civil_sec_pos),
+      hdr.civil_sec_pos ? timecnt : 0);
+  transitions_.prev_civil_sec = ArenaSpan<civil_second>(
+      reinterpret_cast<const civil_second*>(base + hdr.prev_civil_sec_pos),
+      hdr.prev_civil_sec_pos ? timecnt : 0);
+  transitions_.type_index =
+      ArenaSpan<std::uint_least8_t>(type_index, timecnt);
+  transition_types_ = ArenaSpan<TransitionType>(types, typecnt);
+  abbreviations_ = ArenaSpan<char>(base + hdr.abbrs_pos,
+                                   static_cast<std::size_t>(hdr.charcnt));
+  time_index_ = ArenaSpan<std::uint_least32_t>(
+      reinterpret_cast<const std::uint_least32_t*>(base + hdr.time_index_pos),
+      static_cast<std::size_t>(hdr.time_index_cnt));
+  year_index_ = ArenaSpan<std::uint_least32_t>(
+      reinterpret_cast<const std::uint_least32_t*>(base + hdr.year_index_pos),
+      static_cast<std::size_t>(hdr.year_index_cnt));
+  time_index_base_ = hdr.time_index_base;
+  year_index_base_ = hdr.year_index_base;
+  default_transition_type_ = hdr.default_type;
+  extended_ = (hdr.extended != 0);
+  last_year_ = hdr.last_year;
+  future_types_[0] = hdr.future_types[0];
+  future_types_[1] = hdr.future_types[1];
+  steady_ = (hdr.steady != 0);
+  steady_since_unix_ = hdr.steady_since_unix;
+  steady_min_civil_ = hdr.steady_min_civil;
+  version_.assign(base + hdr.arena_len + hdr.speclen,
+                  static_cast<std::size_t>(hdr.verslen));
+  if (hdr.extended == 0) future_spec_.clear();
+  return true;
+#else
+  static_cast<void>(path);
+  return false;
+#endif
+}
+
+namespace {
+
 // fopen(3) adaptor.
 inline FILE* FOpen(const char* path, const char* mode) {
 #if defined(_MSC_VER)
@@ -626,12 +1493,11 @@ class FileZoneInfoSource : public ZoneInfoSource {
   std::size_t len_;
 };
 
-std::unique_ptr<ZoneInfoSource> FileZoneInfoSource::Open(
-    const std::string& name) {
+// Maps a time-zone name to a zoneinfo-file path name.
+std::string ZoneInfoFilePath(const std::string& name) {
   // Use of the "file:" prefix is intended for testing purposes only.
   const std::size_t pos = (name.compare(0, 5, "file:") == 0) ? 5 : 0;
 
-  // Map the time-zone name to a path name.
   std::string path;
   if (pos == name.size() || name[pos] != '/') {
     const char* tzdir = "/usr/share/zoneinfo";
@@ -649,8 +1515,13 @@ std::unique_ptr<ZoneInfoSource> FileZoneInfoSource::Open(
 #endif
   }
   path.append(name, pos, std::string::npos);
+  return path;
+}
 
+std::unique_ptr<ZoneInfoSource> FileZoneInfoSource::Open(
+    const std::string& name) {
   // Open the zoneinfo file.
+  const std::string path = ZoneInfoFilePath(name);
   FILE* fp = FOpen(path.c_str(), "rb");
   if (fp == nullptr) return nullptr;
   std::size_t length = 0;
@@ -664,6 +1535,69 @@ std::unique_ptr<ZoneInfoSource> FileZoneInfoSource::Open(
   return std::unique_ptr<ZoneInfoSource>(new FileZoneInfoSource(fp, length));
 }
 
+#if defined(CCTZ_HAS_MMAP)
+// An mmap(2)-backed implementation of ZoneInfoSource.  The mapping is
+// both read-only and shared, so the kernel serves it from page-cache
+// pages that are common to every process reading the same zoneinfo
+// file, and BorrowBytes() lets TimeZoneInfo::Load() parse the TZif
+// data in place without any intermediate copies.
+class MmapZoneInfoSource : public ZoneInfoSource {
+ public:
+  static std::unique_ptr<ZoneInfoSource> Open(const std::string& name);
+
+  ~MmapZoneInfoSource() override {
+    munmap(const_cast<char*>(data_), len_);
+  }
+
+  std::size_t Read(void* ptr, std::size_t size) override {
+    size = std::min(size, len_ - off_);
+    memcpy(ptr, data_ + off_, size);
+    off_ += size;
+    return size;
+  }
+  int Skip(std::size_t offset) override {
+    off_ += std::min(offset, len_ - off_);
+    return 0;
+  }
+  const char* BorrowBytes(std::size_t size) override {
+    if (size > len_ - off_) return nullptr;
+    const char* bp = data_ + off_;
+    off_ += size;
+    return bp;
+  }
+
+ private:
+  MmapZoneInfoSource(const char* data, std::size_t len)
+      : data_(data), len_(len) {}
+
+  const char* const data_;
+  const std::size_t len_;
+  std::size_t off_ = 0;
+};
+
+std::unique_ptr<ZoneInfoSource> MmapZoneInfoSource::Open(
+    const std::string& name) {
+  const std::string path = ZoneInfoFilePath(name);
+#if defined(O_CLOEXEC)
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#else
+  const int fd = open(path.c_str(), O_RDONLY);
+#endif
+  if (fd == -1) return nullptr;
+  struct stat sb;
+  if (fstat(fd, &sb) != 0 || sb.st_size <= 0) {
+    close(fd);
+    return nullptr;
+  }
+  const std::size_t len = static_cast<std::size_t>(sb.st_size);
+  void* data = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);  // the mapping persists without the descriptor
+  if (data == MAP_FAILED) return nullptr;
+  return std::unique_ptr<ZoneInfoSource>(
+      new MmapZoneInfoSource(static_cast<const char*>(data), len));
+}
+#endif  // CCTZ_HAS_MMAP
+
 class AndroidZoneInfoSource : public FileZoneInfoSource {
  public:
   static std::unique_ptr<ZoneInfoSource> Open(const std::string& name);
@@ -718,6 +1652,222 @@ std::unique_ptr<ZoneInfoSource> AndroidZoneInfoSource::Open(
   return nullptr;
 }
 
+// Reads the entire contents of the file into *data.
+bool ReadFileToString(const std::string& path, std::string* data) {
+  std::unique_ptr<FILE, int (*)(FILE*)> fp(FOpen(path.c_str(), "rb"), fclose);
+  if (fp.get() == nullptr) return false;
+  if (fseek(fp.get(), 0, SEEK_END) != 0) return false;
+  const long offset = ftell(fp.get());
+  if (offset < 0) return false;
+  rewind(fp.get());
+  data->resize(static_cast<std::size_t>(offset));
+  if (data->empty()) return true;
+  return fread(&(*data)[0], 1, data->size(), fp.get()) == data->size();
+}
+
+// A concatenated, indexed tzdata archive: every zone served from one
+// file, opened (and mapped, where possible) just once per process, so
+// that loading a fleet of zones costs a single open/read instead of one
+// per name, and the page-cache footprint is one file rather than a
+// directory tree.
+//
+// The layout (all multi-byte values MSB first, like the TZif encoding):
+//
+//   8-byte magic ("tzarchv" + format version)
+//   4-byte zone count
+//   12-byte tzdata version, NUL padded
+//   zonecnt x (40-byte zone name, NUL padded,
+//              4-byte data offset, 4-byte data length)
+//   the concatenated TZif data
+//
+// Index entries are sorted by name (the NUL padding sorts consistently
+// with byte-wise string comparison) and data offsets are relative to
+// the end of the index. See the --build_tzdata_archive option of
+// time_tool for producing archives.
+const char kTzdataArchiveMagic[] = "tzarchv1";
+const std::size_t kTzdataArchiveMagicLen = sizeof(kTzdataArchiveMagic) - 1;
+const std::size_t kTzdataArchiveVersLen = 12;
+const std::size_t kTzdataArchiveHeaderLen =
+    kTzdataArchiveMagicLen + 4 + kTzdataArchiveVersLen;
+const std::size_t kTzdataArchiveNameLen = 40;
+const std::size_t kTzdataArchiveEntryLen = kTzdataArchiveNameLen + 4 + 4;
+
+class TzdataArchive {
+ public:
+  // Returns the archive at the given path, or nullptr. Each distinct
+  // path is opened at most once per process, with the result (success
+  // or failure) retained forever.
+  static const TzdataArchive* Load(const std::string& path);
+
+  // Locates the named zone's TZif data by pointer arithmetic.
+  bool Find(const std::string& name, const char** data,
+            std::size_t* len) const;
+
+  const std::string& version() const { return version_; }
+
+ private:
+  TzdataArchive() = default;
+  bool Init(const std::string& path);
+
+  std::string buf_;             // backing store when not mmap'd
+  const char* data_ = nullptr;  // the full archive
+  std::size_t len_ = 0;
+  std::size_t zonecnt_ = 0;
+  const char* index_ = nullptr;  // the sorted index entries
+  const char* tzif_ = nullptr;   // start of the concatenated data
+  std::string version_;
+};
+
+bool TzdataArchive::Init(const std::string& path) {
+#if defined(CCTZ_HAS_MMAP)
+  // Map the archive read-only and shared, so the kernel serves it from
+  // page-cache pages common to every process using the same archive.
+  // The mapping is retained for the life of the process.
+#if defined(O_CLOEXEC)
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#else
+  const int fd = open(path.c_str(), O_RDONLY);
+#endif
+  if (fd == -1) return false;
+  struct stat sb;
+  if (fstat(fd, &sb) != 0 || sb.st_size <= 0) {
+    close(fd);
+    return false;
+  }
+  const std::size_t len = static_cast<std::size_t>(sb.st_size);
+  void* data = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);  // the mapping persists without the descriptor
+  if (data == MAP_FAILED) return false;
+  data_ = static_cast<const char*>(data);
+  len_ = len;
+#else
+  if (!ReadFileToString(path, &buf_)) return false;
+  data_ = buf_.data();
+  len_ = buf_.size();
+#endif
+  if (len_ < kTzdataArchiveHeaderLen) return false;
+  if (memcmp(data_, kTzdataArchiveMagic, kTzdataArchiveMagicLen) != 0)
+    return false;
+  const std::int_fast32_t zonecnt = Decode32(data_ + kTzdataArchiveMagicLen);
+  if (zonecnt < 0) return false;
+  zonecnt_ = static_cast<std::size_t>(zonecnt);
+  if ((len_ - kTzdataArchiveHeaderLen) / kTzdataArchiveEntryLen < zonecnt_)
+    return false;
+  const char* vers = data_ + kTzdataArchiveMagicLen + 4;
+  version_.assign(vers, std::find(vers, vers + kTzdataArchiveVersLen, '\0'));
+  index_ = data_ + kTzdataArchiveHeaderLen;
+  tzif_ = index_ + zonecnt_ * kTzdataArchiveEntryLen;
+  return true;
+}
+
+const TzdataArchive* TzdataArchive::Load(const std::string& path) {
+  static std::mutex& mutex = *new std::mutex;
+  static auto& archives =
+      *new std::unordered_map<std::string, const TzdataArchive*>;
+  std::lock_guard<std::mutex> lock(mutex);
+  const auto iter = archives.find(path);
+  if (iter != archives.end()) return iter->second;
+  std::unique_ptr<TzdataArchive> archive(new TzdataArchive);
+  if (!archive->Init(path)) archive.reset();
+  const TzdataArchive* result = archive.release();
+  archives.emplace(path, result);  // negative results are cached too
+  return result;
+}
+
+bool TzdataArchive::Find(const std::string& name, const char** data,
+                         std::size_t* len) const {
+  if (name.size() >= kTzdataArchiveNameLen) return false;
+  char key[kTzdataArchiveNameLen] = {0};
+  memcpy(key, name.data(), name.size());
+  std::size_t lo = 0;
+  std::size_t hi = zonecnt_;
+  while (lo != hi) {
+    const std::size_t mid = lo + (hi - lo) / 2;
+    const char* entry = index_ + mid * kTzdataArchiveEntryLen;
+    const int cmp = memcmp(key, entry, kTzdataArchiveNameLen);
+    if (cmp == 0) {
+      const std::int_fast32_t off = Decode32(entry + kTzdataArchiveNameLen);
+      const std::int_fast32_t length =
+          Decode32(entry + kTzdataArchiveNameLen + 4);
+      if (off < 0 || length < 0) return false;
+      const std::size_t avail =
+          len_ - static_cast<std::size_t>(tzif_ - data_);
+      if (static_cast<std::size_t>(off) > avail ||
+          static_cast<std::size_t>(length) >
+              avail - static_cast<std::size_t>(off)) {
+        return false;
+      }
+      *data = tzif_ + off;
+      *len = static_cast<std::size_t>(length);
+      return true;
+    }
+    if (cmp < 0) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return false;
+}
+
+// Serves a zone's TZif data out of a tzdata archive (see TzdataArchive)
+// located at ${CCTZ_TZDATA}, or at <TZDIR>/tzdata.cctz when that is
+// unset. Like MmapZoneInfoSource, BorrowBytes() lets the TZif data be
+// parsed in place without any intermediate copies.
+class ArchiveZoneInfoSource : public ZoneInfoSource {
+ public:
+  static std::unique_ptr<ZoneInfoSource> Open(const std::string& name);
+
+  std::size_t Read(void* ptr, std::size_t size) override {
+    size = std::min(size, len_ - off_);
+    memcpy(ptr, data_ + off_, size);
+    off_ += size;
+    return size;
+  }
+  int Skip(std::size_t offset) override {
+    off_ += std::min(offset, len_ - off_);
+    return 0;
+  }
+  const char* BorrowBytes(std::size_t size) override {
+    if (size > len_ - off_) return nullptr;
+    const char* bp = data_ + off_;
+    off_ += size;
+    return bp;
+  }
+  std::string Version() const override { return version_; }
+
+ private:
+  ArchiveZoneInfoSource(const char* data, std::size_t len,
+                        const std::string& version)
+      : data_(data), len_(len), version_(version) {}
+
+  const char* const data_;
+  const std::size_t len_;
+  std::size_t off_ = 0;
+  const std::string version_;
+};
+
+std::unique_ptr<ZoneInfoSource> ArchiveZoneInfoSource::Open(
+    const std::string& name) {
+  // Use of the "file:" prefix is intended for testing purposes only.
+  const std::size_t pos = (name.compare(0, 5, "file:") == 0) ? 5 : 0;
+  if (pos == name.size() || name[pos] == '/')
+    return nullptr;  // absolute paths always name individual files
+
+  std::string path;
+  if (const char* tzdata_env = std::getenv("CCTZ_TZDATA")) {
+    if (*tzdata_env != '\0') path = tzdata_env;
+  }
+  if (path.empty()) path = ZoneInfoFilePath("tzdata.cctz");
+  const TzdataArchive* archive = TzdataArchive::Load(path);
+  if (archive == nullptr) return nullptr;
+  const char* data;
+  std::size_t len;
+  if (!archive->Find(name.substr(pos), &data, &len)) return nullptr;
+  return std::unique_ptr<ZoneInfoSource>(
+      new ArchiveZoneInfoSource(data, len, archive->version()));
+}
+
 }  // namespace
 
 bool TimeZoneInfo::Load(const std::string& name) {
@@ -730,9 +1880,38 @@ bool TimeZoneInfo::Load(const std::string& name) {
     return ResetToBuiltinUTC(offset);
   }
 
+#if defined(CCTZ_HAS_MMAP)
+  // A host-shared arena cache, if configured, maps the zone's lookup
+  // data read-only from a prebuilt image, so every process on the host
+  // shares one physical copy. See SerializeArenaImage().
+  if (const char* shared_dir = std::getenv("CCTZ_SHARED_ZONE_DIR")) {
+    if (*shared_dir != '\0' && name.find("..") == std::string::npos) {
+      if (LoadFromArenaImage(std::string(shared_dir) + "/" + name)) {
+        return true;
+      }
+    }
+  }
+#endif
+
+  // An operator-provided compiled-zone cache, if configured, lets us
+  // skip TZif parsing and transition extension entirely.
+  if (const char* cache_dir = std::getenv("CCTZ_ZONE_CACHE_DIR")) {
+    if (*cache_dir != '\0' && name.find("..") == std::string::npos) {
+      std::string data;
+      if (ReadFileToString(std::string(cache_dir) + "/" + name, &data) &&
+          LoadFromCompiledCache(data.data(), data.size())) {
+        return true;
+      }
+    }
+  }
+
   // Find and use a ZoneInfoSource to load the named zone.
   auto zip = cctz_extension::zone_info_source_factory(
       name, [](const std::string& name) -> std::unique_ptr<ZoneInfoSource> {
+        if (auto zip = ArchiveZoneInfoSource::Open(name)) return zip;
+#if defined(CCTZ_HAS_MMAP)
+        if (auto zip = MmapZoneInfoSource::Open(name)) return zip;
+#endif
         if (auto zip = FileZoneInfoSource::Open(name)) return zip;
         if (auto zip = AndroidZoneInfoSource::Open(name)) return zip;
         return nullptr;
@@ -740,6 +1919,59 @@ bool TimeZoneInfo::Load(const std::string& name) {
   return zip != nullptr && Load(name, zip.get());
 }
 
+namespace {
+
+// Per-thread memory of the transitions found during the last BreakTime()
+// and MakeTime() calls, so that a repeat request avoids re-searching.
+// Keeping the hints thread-local (rather than in atomics shared by all
+// threads) means concurrent converters neither ping-pong a cache line
+// nor clobber each other's hints when working in different time ranges.
+// A small direct-mapped table tolerates threads that alternate between
+// a few zones. Entries are only ever hints: the caller revalidates them
+// against the current transition list before use, so a stale entry for
+// a recycled address is harmless.
+struct TransitionHints {
+  const void* zone = nullptr;
+  std::size_t local_time_hint = 0;  // BreakTime() hint
+  std::size_t time_local_hint = 0;  // MakeTime() hint
+};
+
+TransitionHints* ThisThreadHints(const void* zone) {
+  static thread_local TransitionHints hints[4];
+  const auto index = (reinterpret_cast<std::uintptr_t>(zone) >> 4) % 4;
+  TransitionHints* h = &hints[index];
+  if (h->zone != zone) {
+    h->zone = zone;
+    h->local_time_hint = 0;
+    h->time_local_hint = 0;
+  }
+  return h;
+}
+
+}  // namespace
+
+// The civil time of transition i, and of the second preceding it. See
+// the declarations in time_zone_info.h.
+inline civil_second TimeZoneInfo::CivilSecAt(std::size_t i) const {
+#if defined(CCTZ_COMPACT_TRANSITIONS)
+  return (civil_second() + transitions_.unix_time[i]) +
+         transition_types_[transitions_.type_index[i]].utc_offset;
+#else
+  return transitions_.civil_sec[i];
+#endif
+}
+
+inline civil_second TimeZoneInfo::PrevCivilSecAt(std::size_t i) const {
+#if defined(CCTZ_COMPACT_TRANSITIONS)
+  const std::uint_fast8_t prev_type =
+      (i == 0) ? default_transition_type_ : transitions_.type_index[i - 1];
+  return (civil_second() + (transitions_.unix_time[i] - 1)) +
+         transition_types_[prev_type].utc_offset;
+#else
+  return transitions_.prev_civil_sec[i];
+#endif
+}
+
 // BreakTime() translation for a particular transition type.
 time_zone::absolute_lookup TimeZoneInfo::LocalTime(
     std::int_fast64_t unix_time, const TransitionType& tt) const {
@@ -750,35 +1982,132 @@ time_zone::absolute_lookup TimeZoneInfo::LocalTime(
           tt.utc_offset, tt.is_dst, &abbreviations_[tt.abbr_index]};
 }
 
-// BreakTime() translation for a particular transition.
+// BreakTime() translation for the transition at the given index.
 time_zone::absolute_lookup TimeZoneInfo::LocalTime(
-    std::int_fast64_t unix_time, const Transition& tr) const {
-  const TransitionType& tt = transition_types_[tr.type_index];
-  // Note: (unix_time - tr.unix_time) will never overflow as we
-  // have ensured that there is always a "nearby" transition.
-  return {tr.civil_sec + (unix_time - tr.unix_time),  // TODO: Optimize.
+    std::int_fast64_t unix_time, std::size_t index) const {
+  const TransitionType& tt = transition_types_[transitions_.type_index[index]];
+#if defined(CCTZ_COMPACT_TRANSITIONS)
+  // Without the stored civil times there is nothing to save by adding
+  // the delta to the transition; convert from the unix time directly.
+  return LocalTime(unix_time, tt);
+#else
+  // Note: (unix_time - transitions_.unix_time[index]) will never overflow
+  // as we have ensured that there is always a "nearby" transition.
+  return {transitions_.civil_sec[index] +
+              (unix_time - transitions_.unix_time[index]),  // TODO: Optimize.
           tt.utc_offset, tt.is_dst, &abbreviations_[tt.abbr_index]};
+#endif
 }
 
-// MakeTime() translation with a conversion-preserving +N * 400-year shift.
-time_zone::civil_lookup TimeZoneInfo::TimeLocal(const civil_second& cs,
-                                                year_t c4_shift) const {
-  assert(last_year_ - 400 < cs.year() && cs.year() <= last_year_);
-  time_zone::civil_lookup cl = MakeTime(cs);
-  if (c4_shift > seconds::max().count() / kSecsPer400Years) {
-    cl.pre = cl.trans = cl.post = time_point<seconds>::max();
-  } else {
-    const auto offset = seconds(c4_shift * kSecsPer400Years);
-    const auto limit = time_point<seconds>::max() - offset;
-    for (auto* tp : {&cl.pre, &cl.trans, &cl.post}) {
-      if (*tp > limit) {
-        *tp = time_point<seconds>::max();
-      } else {
-        *tp += offset;
-      }
+// The future_spec_ transitions of a single civil year, in civil-time
+// form. wall[i] is the instant of transition i expressed in the local
+// time that prevails just before it; civil_sec[i] and prev_civil_sec[i]
+// match the per-transition fields of Transitions. Everything is kept in
+// the civil domain so that nothing can overflow near the ends of the
+// unix-time line.
+struct TimeZoneInfo::FutureTransitions {
+  civil_second wall[2];
+  civil_second civil_sec[2];
+  civil_second prev_civil_sec[2];
+};
+
+// Evaluates the future_spec_ rule pair for the given year, producing
+// the same transitions that the year would have received had it been
+// pregenerated from the spec.
+void TimeZoneInfo::EvalFutureYear(year_t year, FutureTransitions* ft) const {
+  const TransitionType& tt1 = transition_types_[future_types_[0]];
+  const TransitionType& tt0 = transition_types_[future_types_[1]];
+  const bool leap_year = IsLeap(year);
+  const civil_day jan1(year, 1, 1);
+  const int jan1_weekday = (static_cast<int>(get_weekday(jan1)) + 1) % 7;
+  const PosixTransition& pt1(tt0.is_dst ? posix_.dst_end : posix_.dst_start);
+  const PosixTransition& pt0(tt0.is_dst ? posix_.dst_start : posix_.dst_end);
+  ft->wall[0] = civil_second(jan1) + TransOffset(leap_year, jan1_weekday, pt1);
+  ft->wall[1] = civil_second(jan1) + TransOffset(leap_year, jan1_weekday, pt0);
+  ft->prev_civil_sec[0] = ft->wall[0] - 1;
+  ft->prev_civil_sec[1] = ft->wall[1] - 1;
+  ft->civil_sec[0] = (ft->wall[0] - tt0.utc_offset) + tt1.utc_offset;
+  ft->civil_sec[1] = (ft->wall[1] - tt1.utc_offset) + tt0.utc_offset;
+}
+
+// BreakTime() for instants after the last stored transition, evaluating
+// the future_spec_ rules for the target year on demand.
+time_zone::absolute_lookup TimeZoneInfo::BreakTimeFuture(
+    std::int_fast64_t unix_time) const {
+  const TransitionType& tt1 = transition_types_[future_types_[0]];
+  const TransitionType& tt0 = transition_types_[future_types_[1]];
+
+  // The instant rendered in the local time prevailing before each
+  // in-year transition, for comparison against the wall[] thresholds.
+  const civil_second cs0 = (civil_second() + unix_time) + tt0.utc_offset;
+  const civil_second cs1 = (civil_second() + unix_time) + tt1.utc_offset;
+
+  // Guess the containing year from the year-boundary offset, stepping
+  // to a neighboring year when a rule crosses the boundary.
+  year_t year = cs0.year();
+  FutureTransitions ft;
+  EvalFutureYear(year, &ft);
+  while (cs0 < ft.wall[0]) EvalFutureYear(--year, &ft);
+  while (cs1 >= ft.wall[1]) EvalFutureYear(++year, &ft);
+
+  if (cs0 < ft.wall[0]) return LocalTime(unix_time, tt0);
+  return LocalTime(unix_time, tt1);
+}
+
+// MakeTime() for civil times after the last stored transition,
+// evaluating the future_spec_ rules for the target year on demand.
+time_zone::civil_lookup TimeZoneInfo::MakeTimeFuture(
+    const civil_second& cs) const {
+  const TransitionType& tt1 = transition_types_[future_types_[0]];
+  const TransitionType& tt0 = transition_types_[future_types_[1]];
+
+  // Far beyond the final representable instant under either offset.
+  if (cs.year() > tt0.civil_max.year() + 1) {
+    return MakeUnique(time_point<seconds>::max());
+  }
+
+  year_t year = cs.year();
+  FutureTransitions ft;
+  EvalFutureYear(year, &ft);
+
+  // Step back a year while cs wholly precedes the year's first
+  // transition, and forward while it wholly follows the second (also
+  // handling the gap between one year's rules and the next).
+  while (cs <= ft.prev_civil_sec[0] && cs < ft.civil_sec[0]) {
+    EvalFutureYear(--year, &ft);
+  }
+  while (cs > ft.prev_civil_sec[1] && cs >= ft.civil_sec[1]) {
+    FutureTransitions next;
+    EvalFutureYear(year + 1, &next);
+    if (cs <= next.prev_civil_sec[0] && cs < next.civil_sec[0]) {
+      // Uniquely between this year's rules and the next year's.
+      if (cs > tt0.civil_max) return MakeUnique(time_point<seconds>::max());
+      return MakeUnique(cs - (civil_second() + tt0.utc_offset));
     }
+    ++year;
+    ft = next;
   }
-  return cl;
+
+  if (cs < ft.civil_sec[0]) {  // gap at the year's first transition
+    return MakeSkipped(FutureUnix(ft.wall[0], tt0.utc_offset),
+                       ft.civil_sec[0], ft.prev_civil_sec[0], cs);
+  }
+  if (cs <= ft.prev_civil_sec[0]) {  // fold at the year's first transition
+    return MakeRepeated(FutureUnix(ft.wall[0], tt0.utc_offset),
+                        ft.civil_sec[0], ft.prev_civil_sec[0], cs);
+  }
+  if (ft.prev_civil_sec[1] < cs && cs < ft.civil_sec[1]) {  // gap at the second
+    return MakeSkipped(FutureUnix(ft.wall[1], tt1.utc_offset),
+                       ft.civil_sec[1], ft.prev_civil_sec[1], cs);
+  }
+  if (ft.civil_sec[1] <= cs && cs <= ft.prev_civil_sec[1]) {  // fold
+    return MakeRepeated(FutureUnix(ft.wall[1], tt1.utc_offset),
+                        ft.civil_sec[1], ft.prev_civil_sec[1], cs);
+  }
+
+  // Uniquely between the year's two transitions.
+  if (cs > tt1.civil_max) return MakeUnique(time_point<seconds>::max());
+  return MakeUnique(cs - (civil_second() + tt1.utc_offset));
 }
 
 time_zone::absolute_lookup TimeZoneInfo::BreakTime(
@@ -786,113 +2115,148 @@ time_zone::absolute_lookup TimeZoneInfo::BreakTime(
   std::int_fast64_t unix_time = ToUnixSeconds(tp);
   const std::size_t timecnt = transitions_.size();
   assert(timecnt != 0);  // We always add a transition.
+  CCTZ_STATS_COUNT(counters_.break_time_calls);
 
-  if (unix_time < transitions_[0].unix_time) {
+  if (steady_ && unix_time >= steady_since_unix_) {
+    // Within the zone's final fixed-offset regime: no search required.
+    return LocalTime(unix_time, timecnt - 1);
+  }
+
+  if (unix_time < transitions_.unix_time[0]) {
     return LocalTime(unix_time, transition_types_[default_transition_type_]);
   }
-  if (unix_time >= transitions_[timecnt - 1].unix_time) {
-    // After the last transition. If we extended the transitions using
-    // future_spec_, shift back to a supported year using the 400-year
-    // cycle of calendaric equivalence and then compensate accordingly.
-    if (extended_) {
-      const std::int_fast64_t diff =
-          unix_time - transitions_[timecnt - 1].unix_time;
-      const year_t shift = diff / kSecsPer400Years + 1;
-      const auto d = seconds(shift * kSecsPer400Years);
-      time_zone::absolute_lookup al = BreakTime(tp - d);
-      al.cs = YearShift(al.cs, shift * 400);
-      return al;
-    }
-    return LocalTime(unix_time, transitions_[timecnt - 1]);
+  if (unix_time >= transitions_.unix_time[timecnt - 1]) {
+    // After the last transition. If we have a future_spec_, evaluate
+    // its rules for the target year on demand.
+    if (extended_) return BreakTimeFuture(unix_time);
+    return LocalTime(unix_time, timecnt - 1);
   }
 
-  const std::size_t hint = local_time_hint_.load(std::memory_order_relaxed);
+  TransitionHints* hints = ThisThreadHints(this);
+  const std::size_t hint = hints->local_time_hint;
   if (0 < hint && hint < timecnt) {
-    if (transitions_[hint - 1].unix_time <= unix_time) {
-      if (unix_time < transitions_[hint].unix_time) {
-        return LocalTime(unix_time, transitions_[hint - 1]);
+    if (transitions_.unix_time[hint - 1] <= unix_time) {
+      if (unix_time < transitions_.unix_time[hint]) {
+        CCTZ_STATS_COUNT(counters_.break_time_hint_hits);
+        return LocalTime(unix_time, hint - 1);
       }
     }
   }
 
-  const Transition target = {unix_time, 0, civil_second(), civil_second()};
-  const Transition* begin = &transitions_[0];
-  const Transition* tr = std::upper_bound(begin, begin + timecnt, target,
-                                          Transition::ByUnixTime());
-  local_time_hint_.store(static_cast<std::size_t>(tr - begin),
-                         std::memory_order_relaxed);
-  return LocalTime(unix_time, *--tr);
+  const std::size_t ub = UpperBoundUnix(unix_time);
+  hints->local_time_hint = ub;
+  return LocalTime(unix_time, ub - 1);
+}
+
+void TimeZoneInfo::BreakTimeBatch(const time_point<seconds>* tps,
+                                  std::size_t n,
+                                  time_zone::absolute_lookup* als) const {
+  const std::size_t timecnt = transitions_.size();
+  assert(timecnt != 0);  // We always add a transition.
+
+  // The hint is carried in a local so that runs of time points falling
+  // within the same transition interval (the common case for sorted or
+  // clustered inputs) resolve their transition just once, without any
+  // shared-state traffic.
+  std::size_t hint = 0;
+  for (std::size_t i = 0; i != n; ++i) {
+    const std::int_fast64_t unix_time = ToUnixSeconds(tps[i]);
+    if (unix_time < transitions_.unix_time[0] ||
+        unix_time >= transitions_.unix_time[timecnt - 1]) {
+      // Defer to BreakTime() for the before-first/after-last handling.
+      als[i] = BreakTime(tps[i]);
+      continue;
+    }
+    if (!(0 < hint && transitions_.unix_time[hint - 1] <= unix_time &&
+          unix_time < transitions_.unix_time[hint])) {
+      hint = UpperBoundUnix(unix_time);
+    }
+    als[i] = LocalTime(unix_time, hint - 1);
+  }
 }
 
 time_zone::civil_lookup TimeZoneInfo::MakeTime(const civil_second& cs) const {
   const std::size_t timecnt = transitions_.size();
   assert(timecnt != 0);  // We always add a transition.
+  CCTZ_STATS_COUNT(counters_.make_time_calls);
+
+  if (steady_ && cs >= steady_min_civil_) {
+    // Within the zone's final fixed-offset regime: no search required.
+    const std::size_t last = timecnt - 1;
+    const TransitionType& tt(transition_types_[transitions_.type_index[last]]);
+    if (cs > tt.civil_max) return MakeUnique(time_point<seconds>::max());
+    return MakeUnique(transitions_.unix_time[last] + (cs - CivilSecAt(last)));
+  }
 
   // Find the first transition after our target civil time.
-  const Transition* tr = nullptr;
-  const Transition* begin = &transitions_[0];
-  const Transition* end = begin + timecnt;
-  if (cs < begin->civil_sec) {
-    tr = begin;
-  } else if (cs >= transitions_[timecnt - 1].civil_sec) {
-    tr = end;
+  std::size_t tr = timecnt;  // "not yet found" while searching
+  bool found = false;
+  if (cs < CivilSecAt(0)) {
+    tr = 0;
+    found = true;
+  } else if (cs >= CivilSecAt(timecnt - 1)) {
+    tr = timecnt;
+    found = true;
   } else {
-    const std::size_t hint = time_local_hint_.load(std::memory_order_relaxed);
+    TransitionHints* hints = ThisThreadHints(this);
+    const std::size_t hint = hints->time_local_hint;
     if (0 < hint && hint < timecnt) {
-      if (transitions_[hint - 1].civil_sec <= cs) {
-        if (cs < transitions_[hint].civil_sec) {
-          tr = begin + hint;
+      if (CivilSecAt(hint - 1) <= cs) {
+        if (cs < CivilSecAt(hint)) {
+          CCTZ_STATS_COUNT(counters_.make_time_hint_hits);
+          tr = hint;
+          found = true;
         }
       }
     }
-    if (tr == nullptr) {
-      const Transition target = {0, 0, cs, civil_second()};
-      tr = std::upper_bound(begin, end, target, Transition::ByCivilTime());
-      time_local_hint_.store(static_cast<std::size_t>(tr - begin),
-                             std::memory_order_relaxed);
+    if (!found) {
+      tr = UpperBoundCivil(cs);
+      hints->time_local_hint = tr;
     }
   }
 
-  if (tr == begin) {
-    if (tr->prev_civil_sec >= cs) {
+  if (tr == 0) {
+    if (PrevCivilSecAt(0) >= cs) {
       // Before first transition, so use the default offset.
       const TransitionType& tt(transition_types_[default_transition_type_]);
       if (cs < tt.civil_min) return MakeUnique(time_point<seconds>::min());
       return MakeUnique(cs - (civil_second() + tt.utc_offset));
     }
-    // tr->prev_civil_sec < cs < tr->civil_sec
-    return MakeSkipped(*tr, cs);
+    // PrevCivilSecAt(0) < cs < CivilSecAt(0)
+    return MakeSkipped(transitions_.unix_time[0], CivilSecAt(0),
+                       PrevCivilSecAt(0), cs);
   }
 
-  if (tr == end) {
-    if (cs > (--tr)->prev_civil_sec) {
-      // After the last transition. If we extended the transitions using
-      // future_spec_, shift back to a supported year using the 400-year
-      // cycle of calendaric equivalence and then compensate accordingly.
-      if (extended_ && cs.year() > last_year_) {
-        const year_t shift = (cs.year() - last_year_ - 1) / 400 + 1;
-        return TimeLocal(YearShift(cs, shift * -400), shift);
-      }
-      const TransitionType& tt(transition_types_[tr->type_index]);
+  if (tr == timecnt) {
+    --tr;
+    if (cs > PrevCivilSecAt(tr)) {
+      // After the last transition. If we have a future_spec_, evaluate
+      // its rules for the target year on demand.
+      if (extended_) return MakeTimeFuture(cs);
+      const TransitionType& tt(transition_types_[transitions_.type_index[tr]]);
       if (cs > tt.civil_max) return MakeUnique(time_point<seconds>::max());
-      return MakeUnique(tr->unix_time + (cs - tr->civil_sec));
+      return MakeUnique(transitions_.unix_time[tr] + (cs - CivilSecAt(tr)));
     }
-    // tr->civil_sec <= cs <= tr->prev_civil_sec
-    return MakeRepeated(*tr, cs);
+    // CivilSecAt(tr) <= cs <= PrevCivilSecAt(tr)
+    return MakeRepeated(transitions_.unix_time[tr], CivilSecAt(tr),
+                        PrevCivilSecAt(tr), cs);
   }
 
-  if (tr->prev_civil_sec < cs) {
-    // tr->prev_civil_sec < cs < tr->civil_sec
-    return MakeSkipped(*tr, cs);
+  if (PrevCivilSecAt(tr) < cs) {
+    // PrevCivilSecAt(tr) < cs < CivilSecAt(tr)
+    return MakeSkipped(transitions_.unix_time[tr], CivilSecAt(tr),
+                       PrevCivilSecAt(tr), cs);
   }
 
-  if (cs <= (--tr)->prev_civil_sec) {
-    // tr->civil_sec <= cs <= tr->prev_civil_sec
-    return MakeRepeated(*tr, cs);
+  --tr;
+  if (cs <= PrevCivilSecAt(tr)) {
+    // CivilSecAt(tr) <= cs <= PrevCivilSecAt(tr)
+    return MakeRepeated(transitions_.unix_time[tr], CivilSecAt(tr),
+                        PrevCivilSecAt(tr), cs);
   }
 
   // In between transitions.
-  return MakeUnique(tr->unix_time + (cs - tr->civil_sec));
+  return MakeUnique(transitions_.unix_time[tr] + (cs - CivilSecAt(tr)));
 }
 
 std::string TimeZoneInfo::Version() const {
@@ -907,38 +2271,88 @@ std::string TimeZoneInfo::Description() const {
   return oss.str();
 }
 
+#if defined(CCTZ_ENABLE_STATS)
+void TimeZoneInfo::CollectStats(debug::zone_stats* stats) const {
+  stats->break_time_calls += counters_.break_time_calls.Value();
+  stats->break_time_hint_hits += counters_.break_time_hint_hits.Value();
+  stats->make_time_calls += counters_.make_time_calls.Value();
+  stats->make_time_hint_hits += counters_.make_time_hint_hits.Value();
+  stats->search_steps += counters_.search_steps.Value();
+}
+
+void TimeZoneInfo::ResetStats() const {
+  counters_.break_time_calls.Reset();
+  counters_.break_time_hint_hits.Reset();
+  counters_.make_time_calls.Reset();
+  counters_.make_time_hint_hits.Reset();
+  counters_.search_steps.Reset();
+}
+#endif
+
 bool TimeZoneInfo::NextTransition(const time_point<seconds>& tp,
                                   time_zone::civil_transition* trans) const {
   if (transitions_.empty()) return false;
-  const Transition* begin = &transitions_[0];
-  const Transition* end = begin + transitions_.size();
-  if (begin->unix_time <= -(1LL << 59)) {
+  const ArenaSpan<std::int_least64_t>& keys = transitions_.unix_time;
+  std::size_t begin = 0;
+  const std::size_t end = transitions_.size();
+  if (keys[begin] <= -(1LL << 59)) {
     // Do not report the BIG_BANG found in recent zoneinfo data as it is
     // really a sentinel, not a transition.  See tz/zic.c.
     ++begin;
   }
   std::int_fast64_t unix_time = ToUnixSeconds(tp);
-  const Transition target = {unix_time, 0, civil_second(), civil_second()};
-  const Transition* tr = std::upper_bound(begin, end, target,
-                                          Transition::ByUnixTime());
+  std::size_t tr = static_cast<std::size_t>(
+      std::upper_bound(keys.begin() + begin, keys.end(), unix_time) -
+      keys.begin());
   for (; tr != end; ++tr) {  // skip no-op transitions
-    std::uint_fast8_t prev_type_index =
-        (tr == begin) ? default_transition_type_ : tr[-1].type_index;
-    if (!EquivTransitions(prev_type_index, tr[0].type_index)) break;
+    std::uint_fast8_t prev_type_index = (tr == begin)
+                                            ? default_transition_type_
+                                            : transitions_.type_index[tr - 1];
+    if (!EquivTransitions(transition_types_[prev_type_index],
+                          transition_types_[transitions_.type_index[tr]])) {
+      break;
+    }
   }
-  // When tr == end we return false, ignoring future_spec_.
-  if (tr == end) return false;
-  trans->from = tr->prev_civil_sec + 1;
-  trans->to = tr->civil_sec;
+  if (tr == end) {
+    if (!extended_) return false;  // Ignore future_spec_.
+    if (unix_time == std::numeric_limits<std::int_fast64_t>::max()) {
+      return false;  // no representable time follows tp
+    }
+    // The next transition comes from the on-demand future rules.
+    const TransitionType& ftt1 = transition_types_[future_types_[0]];
+    const TransitionType& ftt0 = transition_types_[future_types_[1]];
+    const civil_second cs0 = (civil_second() + unix_time) + ftt0.utc_offset;
+    const civil_second cs1 = (civil_second() + unix_time) + ftt1.utc_offset;
+    year_t year = cs0.year() - 1;
+    if (year < last_year_ + 1) year = last_year_ + 1;
+    FutureTransitions ft;
+    EvalFutureYear(year, &ft);
+    for (;;) {
+      if (cs0 < ft.wall[0]) {  // before the year's first rule transition
+        trans->from = ft.prev_civil_sec[0] + 1;
+        trans->to = ft.civil_sec[0];
+        return true;
+      }
+      if (cs1 < ft.wall[1]) {  // before the year's second rule transition
+        trans->from = ft.prev_civil_sec[1] + 1;
+        trans->to = ft.civil_sec[1];
+        return true;
+      }
+      EvalFutureYear(++year, &ft);
+    }
+  }
+  trans->from = PrevCivilSecAt(tr) + 1;
+  trans->to = CivilSecAt(tr);
   return true;
 }
 
 bool TimeZoneInfo::PrevTransition(const time_point<seconds>& tp,
                                   time_zone::civil_transition* trans) const {
   if (transitions_.empty()) return false;
-  const Transition* begin = &transitions_[0];
-  const Transition* end = begin + transitions_.size();
-  if (begin->unix_time <= -(1LL << 59)) {
+  const ArenaSpan<std::int_least64_t>& keys = transitions_.unix_time;
+  std::size_t begin = 0;
+  std::size_t end = transitions_.size();
+  if (keys[begin] <= -(1LL << 59)) {
     // Do not report the BIG_BANG found in recent zoneinfo data as it is
     // really a sentinel, not a transition.  See tz/zic.c.
     ++begin;
@@ -946,26 +2360,119 @@ bool TimeZoneInfo::PrevTransition(const time_point<seconds>& tp,
   std::int_fast64_t unix_time = ToUnixSeconds(tp);
   if (FromUnixSeconds(unix_time) != tp) {
     if (unix_time == std::numeric_limits<std::int_fast64_t>::max()) {
-      if (end == begin) return false;  // Ignore future_spec_.
-      trans->from = (--end)->prev_civil_sec + 1;
-      trans->to = end->civil_sec;
-      return true;
+      if (end == begin) return false;
+      if (!extended_) {  // Ignore future_spec_.
+        --end;
+        trans->from = PrevCivilSecAt(end) + 1;
+        trans->to = CivilSecAt(end);
+        return true;
+      }
+      // The future-rule walk below treats unix_time as an exclusive
+      // upper bound, which is what an unrepresentable tp calls for.
+    } else {
+      unix_time += 1;  // ceils
+    }
+  }
+  if (extended_ && end != begin && unix_time > keys[end - 1]) {
+    // The previous transition may come from the on-demand future rules.
+    const TransitionType& ftt1 = transition_types_[future_types_[0]];
+    const TransitionType& ftt0 = transition_types_[future_types_[1]];
+    const civil_second cs0 = (civil_second() + unix_time) + ftt0.utc_offset;
+    const civil_second cs1 = (civil_second() + unix_time) + ftt1.utc_offset;
+    year_t year = cs0.year() + 1;
+    FutureTransitions ft;
+    EvalFutureYear(year, &ft);
+    for (;;) {
+      if (cs1 > ft.wall[1]) {  // past the year's second rule transition
+        trans->from = ft.prev_civil_sec[1] + 1;
+        trans->to = ft.civil_sec[1];
+        return true;
+      }
+      if (cs0 > ft.wall[0]) {  // past the year's first rule transition
+        trans->from = ft.prev_civil_sec[0] + 1;
+        trans->to = ft.civil_sec[0];
+        return true;
+      }
+      if (year == last_year_ + 1) break;  // previous is in the stored data
+      EvalFutureYear(--year, &ft);
     }
-    unix_time += 1;  // ceils
   }
-  const Transition target = {unix_time, 0, civil_second(), civil_second()};
-  const Transition* tr = std::lower_bound(begin, end, target,
-                                          Transition::ByUnixTime());
+  std::size_t tr = static_cast<std::size_t>(
+      std::lower_bound(keys.begin() + begin, keys.begin() + end, unix_time) -
+      keys.begin());
   for (; tr != begin; --tr) {  // skip no-op transitions
     std::uint_fast8_t prev_type_index =
-        (tr - 1 == begin) ? default_transition_type_ : tr[-2].type_index;
-    if (!EquivTransitions(prev_type_index, tr[-1].type_index)) break;
+        (tr - 1 == begin) ? default_transition_type_
+                          : transitions_.type_index[tr - 2];
+    if (!EquivTransitions(
+            transition_types_[prev_type_index],
+            transition_types_[transitions_.type_index[tr - 1]])) {
+      break;
+    }
   }
   // When tr == end we return the "last" transition, ignoring future_spec_.
   if (tr == begin) return false;
-  trans->from = (--tr)->prev_civil_sec + 1;
-  trans->to = tr->civil_sec;
+  --tr;
+  trans->from = PrevCivilSecAt(tr) + 1;
+  trans->to = CivilSecAt(tr);
   return true;
 }
 
+void TimeZoneInfo::TransitionRange(
+    const time_point<seconds>& from, const time_point<seconds>& to,
+    std::vector<time_zone::civil_transition>* trans) const {
+  if (transitions_.empty() || !(from < to)) return;
+  const ArenaSpan<std::int_least64_t>& keys = transitions_.unix_time;
+  std::size_t begin = 0;
+  const std::size_t end = transitions_.size();
+  if (keys[begin] <= -(1LL << 59)) {
+    // Do not report the BIG_BANG found in recent zoneinfo data as it is
+    // really a sentinel, not a transition.  See tz/zic.c.
+    ++begin;
+  }
+  const std::int_fast64_t lo = ToUnixSeconds(from);
+  const std::int_fast64_t hi = ToUnixSeconds(to);
+  // Position once, then walk the stored transitions sequentially.
+  std::size_t tr = static_cast<std::size_t>(
+      std::upper_bound(keys.begin() + begin, keys.end(), lo) - keys.begin());
+  std::uint_fast8_t prev_type_index = (tr == begin)
+                                          ? default_transition_type_
+                                          : transitions_.type_index[tr - 1];
+  for (; tr != end && keys[tr] <= hi; ++tr) {
+    if (!EquivTransitions(transition_types_[prev_type_index],
+                          transition_types_[transitions_.type_index[tr]])) {
+      trans->push_back(time_zone::civil_transition{
+          PrevCivilSecAt(tr) + 1, CivilSecAt(tr)});
+    }
+    prev_type_index = transitions_.type_index[tr];
+  }
+  if (tr != end || !extended_) return;  // window or stored data exhausted
+  if (lo == std::numeric_limits<std::int_fast64_t>::max()) return;
+
+  // Continue through the on-demand future rules, a year pair at a time.
+  const TransitionType& ftt1 = transition_types_[future_types_[0]];
+  const TransitionType& ftt0 = transition_types_[future_types_[1]];
+  const civil_second lo0 = (civil_second() + lo) + ftt0.utc_offset;
+  const civil_second lo1 = (civil_second() + lo) + ftt1.utc_offset;
+  const civil_second hi0 = (civil_second() + hi) + ftt0.utc_offset;
+  const civil_second hi1 = (civil_second() + hi) + ftt1.utc_offset;
+  year_t year = lo0.year() - 1;
+  if (year < last_year_ + 1) year = last_year_ + 1;
+  FutureTransitions ft;
+  EvalFutureYear(year, &ft);
+  for (;;) {
+    if (hi0 < ft.wall[0]) break;  // the year's first rule transition
+    if (lo0 < ft.wall[0]) {
+      trans->push_back(time_zone::civil_transition{
+          ft.prev_civil_sec[0] + 1, ft.civil_sec[0]});
+    }
+    if (hi1 < ft.wall[1]) break;  // the year's second rule transition
+    if (lo1 < ft.wall[1]) {
+      trans->push_back(time_zone::civil_transition{
+          ft.prev_civil_sec[1] + 1, ft.civil_sec[1]});
+    }
+    EvalFutureYear(++year, &ft);
+  }
+}
+
 }  // namespace cctz
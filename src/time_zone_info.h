@@ -15,37 +15,101 @@
 #ifndef CCTZ_TIME_ZONE_INFO_H_
 #define CCTZ_TIME_ZONE_INFO_H_
 
-#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "cctz/civil_time.h"
 #include "cctz/time_zone.h"
 #include "cctz/zone_info_source.h"
+#include "debug_stats.h"
 #include "time_zone_if.h"
+#include "time_zone_posix.h"
 #include "tzfile.h"
 
 namespace cctz {
 
-// A transition to a new UTC offset.
-struct Transition {
-  std::int_least64_t unix_time;   // the instant of this transition
-  std::uint_least8_t type_index;  // index of the transition type
-  civil_second civil_sec;         // local civil time of transition
-  civil_second prev_civil_sec;    // local civil time one second earlier
-
-  struct ByUnixTime {
-    inline bool operator()(const Transition& lhs, const Transition& rhs) const {
-      return lhs.unix_time < rhs.unix_time;
-    }
-  };
-  struct ByCivilTime {
-    inline bool operator()(const Transition& lhs, const Transition& rhs) const {
-      return lhs.civil_sec < rhs.civil_sec;
-    }
-  };
+// The transitions to new UTC offsets, stored structure-of-arrays style:
+// each field lives in its own dense parallel array so that the searches
+// in BreakTime() (keyed by unix_time) and MakeTime() (keyed by
+// civil_sec) touch only the keys they compare, rather than dragging the
+// unused fields of an interleaved struct through the cache with every
+// probe. The arrays always have equal lengths, and entry i describes
+// the i-th transition.
+//
+// This growable form is load-time scratch: once the transition set is
+// final it is copied into the zone's arena (see
+// TimeZoneInfo::CommitToArena()) and these vectors are discarded.
+struct Transitions {
+  std::vector<std::int_least64_t> unix_time;   // transition instants, ordered
+  std::vector<civil_second> civil_sec;         // local civil times, ordered
+  std::vector<civil_second> prev_civil_sec;    // civil times one second earlier
+  std::vector<std::uint_least8_t> type_index;  // transition-type indexes
+
+  std::size_t size() const { return unix_time.size(); }
+  bool empty() const { return unix_time.empty(); }
+  void clear() {
+    unix_time.clear();
+    civil_sec.clear();
+    prev_civil_sec.clear();
+    type_index.clear();
+  }
+  void reserve(std::size_t n) {
+    unix_time.reserve(n);
+    civil_sec.reserve(n);
+    prev_civil_sec.reserve(n);
+    type_index.reserve(n);
+  }
+  void resize(std::size_t n) {
+    unix_time.resize(n);
+    civil_sec.resize(n);
+    prev_civil_sec.resize(n);
+    type_index.resize(n);
+  }
+  void push_front(std::int_least64_t t, std::uint_least8_t ti) {
+    unix_time.insert(unix_time.begin(), t);
+    civil_sec.insert(civil_sec.begin(), civil_second());
+    prev_civil_sec.insert(prev_civil_sec.begin(), civil_second());
+    type_index.insert(type_index.begin(), ti);
+  }
+};
+
+// A borrowed view of a contiguous array placed in the zone's arena.
+// Deliberately minimal: just what the lookup paths need.
+template <typename T>
+class ArenaSpan {
+ public:
+  ArenaSpan() : data_(nullptr), size_(0) {}
+  ArenaSpan(const T* data, std::size_t size) : data_(data), size_(size) {}
+
+  const T* begin() const { return data_; }
+  const T* end() const { return data_ + size_; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const T& operator[](std::size_t i) const { return data_[i]; }
+  const T& front() const { return data_[0]; }
+  const T& back() const { return data_[size_ - 1]; }
+
+ private:
+  const T* data_;
+  std::size_t size_;
+};
+
+// The committed form of Transitions: the same parallel arrays, but as
+// views into the zone's arena. (When compiled with
+// -DCCTZ_COMPACT_TRANSITIONS the civil_sec and prev_civil_sec views are
+// left empty and the values are derived on demand; see
+// TimeZoneInfo::CivilSecAt().)
+struct TransitionsView {
+  ArenaSpan<std::int_least64_t> unix_time;
+  ArenaSpan<civil_second> civil_sec;
+  ArenaSpan<civil_second> prev_civil_sec;
+  ArenaSpan<std::uint_least8_t> type_index;
+
+  std::size_t size() const { return unix_time.size(); }
+  bool empty() const { return unix_time.empty(); }
 };
 
 // The characteristics of a particular transition.
@@ -63,22 +127,70 @@ class TimeZoneInfo : public TimeZoneIf {
   TimeZoneInfo() = default;
   TimeZoneInfo(const TimeZoneInfo&) = delete;
   TimeZoneInfo& operator=(const TimeZoneInfo&) = delete;
+  ~TimeZoneInfo() override;  // unmaps a shared arena image, if any
 
   // Loads the zoneinfo for the given name, returning true if successful.
   bool Load(const std::string& name);
 
+  // Loads the zone described by a POSIX TZ rule string (e.g.,
+  // "PST8PDT,M3.2.0,M11.1.0"), which is how libc interprets ${TZ}
+  // values that do not name any zoneinfo data. The rules are applied
+  // by the same future-transition machinery used for a TZif file's
+  // trailing specification, so these zones get the normal lock-free,
+  // hint-accelerated lookups rather than falling back to localtime_r().
+  bool ResetToPosixSpec(const std::string& spec);
+
+  // Serializes the fully loaded state (transitions, transition types,
+  // abbreviations, and the POSIX future spec) into a compiled-cache
+  // record that LoadFromCompiledCache() can reload without any TZif
+  // parsing, transition extension, or civil-time recomputation.  The
+  // record is versioned, and its fixed-width MSB-first encoding is
+  // portable across architectures.
+  //
+  // Load() consults ${CCTZ_ZONE_CACHE_DIR}/<name> for such records
+  // before falling back to the normal zoneinfo sources.  See the
+  // --compile_zone_cache option of time_tool for producing them.
+  bool SerializeCompiledCache(std::string* out) const;
+  bool LoadFromCompiledCache(const char* data, std::size_t len);
+
+  // Serializes the committed arena (and the scalar state that frames
+  // it) as a byte-for-byte image of the in-memory form, and loads such
+  // an image by mapping it read-only and shared, so that every process
+  // on a host serves its lookups from one physical copy of the zone
+  // data.  Unlike the compiled-cache records above, an image is only
+  // meaningful between identical builds on one host (an embedded ABI
+  // tag enforces this); put the image files on a tmpfs (e.g.,
+  // /dev/shm) or any local filesystem — the shared mapping is what
+  // dedupes the memory.
+  //
+  // Load() consults ${CCTZ_SHARED_ZONE_DIR}/<name> for images before
+  // any other source.  See the --share_zone_cache option of time_tool
+  // for producing them.  Requires mmap(); loading fails otherwise.
+  bool SerializeArenaImage(std::string* out) const;
+  bool LoadFromArenaImage(const std::string& path);
+
   // TimeZoneIf implementations.
   time_zone::absolute_lookup BreakTime(
       const time_point<seconds>& tp) const override;
   time_zone::civil_lookup MakeTime(
       const civil_second& cs) const override;
+  void BreakTimeBatch(const time_point<seconds>* tps, std::size_t n,
+                      time_zone::absolute_lookup* als) const override;
   bool NextTransition(const time_point<seconds>& tp,
                       time_zone::civil_transition* trans) const override;
   bool PrevTransition(const time_point<seconds>& tp,
                       time_zone::civil_transition* trans) const override;
+  void TransitionRange(
+      const time_point<seconds>& from, const time_point<seconds>& to,
+      std::vector<time_zone::civil_transition>* trans) const override;
   std::string Version() const override;
   std::string Description() const override;
 
+#if defined(CCTZ_ENABLE_STATS)
+  void CollectStats(debug::zone_stats* stats) const override;
+  void ResetStats() const override;
+#endif
+
  private:
   struct Header {  // counts of:
     std::size_t timecnt;     // transition times
@@ -95,36 +207,109 @@ class TimeZoneInfo : public TimeZoneIf {
   void CheckTransition(const std::string& name, const TransitionType& tt,
                        std::int_fast32_t offset, bool is_dst,
                        const std::string& abbr) const;
-  bool EquivTransitions(std::uint_fast8_t tt1_index,
-                        std::uint_fast8_t tt2_index) const;
-  void ExtendTransitions(const std::string& name, const Header& hdr);
+  static bool EquivTransitions(const TransitionType& tt1,
+                               const TransitionType& tt2);
+  void ExtendTransitions(const std::string& name, const Header& hdr,
+                         const std::vector<TransitionType>& types,
+                         Transitions* trans);
 
   bool ResetToBuiltinUTC(const seconds& offset);
   bool Load(const std::string& name, ZoneInfoSource* zip);
 
+  // Finalizes a load: builds the search indexes, sizes and allocates
+  // the arena, copies the scratch data into it, and points the member
+  // views at their placements.
+  void CommitToArena(const Transitions& trans,
+                     const std::vector<TransitionType>& types,
+                     const std::string& abbrs);
+
+  // Search-index construction and lookup. See BuildSearchIndex().
+  void BuildSearchIndex(const Transitions& trans,
+                        std::vector<std::uint_least32_t>* time_index,
+                        std::vector<std::uint_least32_t>* year_index);
+  std::size_t UpperBoundUnix(std::int_fast64_t unix_time) const;
+  std::size_t UpperBoundCivil(const civil_second& cs) const;
+
   // Helpers for BreakTime() and MakeTime().
   time_zone::absolute_lookup LocalTime(std::int_fast64_t unix_time,
                                        const TransitionType& tt) const;
   time_zone::absolute_lookup LocalTime(std::int_fast64_t unix_time,
-                                       const Transition& tr) const;
-  time_zone::civil_lookup TimeLocal(const civil_second& cs,
-                                    year_t c4_shift) const;
+                                       std::size_t index) const;
+
+  // The civil time of transition i, and of the second preceding it
+  // (the final civil second of the previous offset regime). Normally
+  // these read the stored arrays; when compiled with
+  // -DCCTZ_COMPACT_TRANSITIONS they are derived on demand from
+  // unix_time and the bracketing transition types, roughly halving a
+  // zone's arena at the cost of a few cycles per derivation.
+  civil_second CivilSecAt(std::size_t i) const;
+  civil_second PrevCivilSecAt(std::size_t i) const;
 
-  std::vector<Transition> transitions_;  // ordered by unix_time and civil_sec
-  std::vector<TransitionType> transition_types_;  // distinct transition types
+  // On-demand evaluation of the future_spec_ rules for times after the
+  // last stored transition. See EvalFutureYear() in time_zone_info.cc.
+  struct FutureTransitions;
+  void EvalFutureYear(year_t year, FutureTransitions* ft) const;
+  time_zone::absolute_lookup BreakTimeFuture(std::int_fast64_t unix_time) const;
+  time_zone::civil_lookup MakeTimeFuture(const civil_second& cs) const;
+
+  // One contiguous allocation holding all the steady-state zone data;
+  // the views below point into it. Packing the transitions, transition
+  // types, abbreviations, and search indexes into a single block makes
+  // a zone one allocation instead of seven and keeps its lookup data in
+  // one cache-warm region. (Only the cold metadata strings below, and
+  // the parsed POSIX spec, remain separately allocated.)
+  //
+  // The arena bytes are either owned here (arena_) or borrowed from a
+  // host-shared read-only mapping (mapped_image_); arena_base_/arena_len_
+  // describe them either way. See LoadFromArenaImage().
+  std::unique_ptr<char[]> arena_;
+  const char* arena_base_ = nullptr;
+  std::size_t arena_len_ = 0;
+  const char* mapped_image_ = nullptr;  // the whole mapped image file
+  std::size_t mapped_image_len_ = 0;
+
+  TransitionsView transitions_;  // ordered by unix_time and civil_sec
+  ArenaSpan<TransitionType> transition_types_;  // distinct transition types
   std::uint_fast8_t default_transition_type_;  // for before first transition
-  std::string abbreviations_;  // all the NUL-terminated abbreviations
+  ArenaSpan<char> abbreviations_;  // all the NUL-terminated abbreviations
 
   std::string version_;      // the tzdata version if available
   std::string future_spec_;  // for after the last zic transition
-  bool extended_;            // future_spec_ was used to generate transitions
-  year_t last_year_;         // the final year of the generated transitions
-
-  // We remember the transitions found during the last BreakTime() and
-  // MakeTime() calls. If the next request is for the same transition we
-  // will avoid re-searching.
-  mutable std::atomic<std::size_t> local_time_hint_ = {};  // BreakTime() hint
-  mutable std::atomic<std::size_t> time_local_hint_ = {};  // MakeTime() hint
+  bool extended_;            // future_spec_ is evaluated for future times
+  year_t last_year_;         // the final year of the stored transitions
+  PosixTimeZone posix_;      // the parsed future_spec_, when extended_
+  std::uint_least8_t future_types_[2];  // the types after the first and
+                                        // second rule transitions within
+                                        // a future year
+
+  // Set when the zone has settled into a single fixed offset: there are
+  // no future rule transitions (extended_ is false) and every stored
+  // transition at or after steady_since_unix_ has an equivalent type.
+  // Lookups of such instants — the steady state for the many zones that
+  // no longer observe DST — short-circuit to pure arithmetic, with no
+  // hint or search-index probes. See CommitToArena().
+  bool steady_ = false;
+  std::int_least64_t steady_since_unix_;  // first instant of the final regime
+  civil_second steady_min_civil_;  // its first unambiguous civil time
+
+  // Flat bucket indexes over the transitions, built once after loading,
+  // that reduce a hint-miss search to one array load plus a forward scan
+  // of the few transitions per bucket. An entry is the largest transition
+  // index at or before the start of its bucket. Empty when unbuildable
+  // (then searches fall back to binary search).
+  ArenaSpan<std::uint_least32_t> time_index_;  // fixed-width unix-time buckets
+  ArenaSpan<std::uint_least32_t> year_index_;  // civil-year buckets
+  std::int_fast64_t time_index_base_ = 0;  // unix time of bucket 0
+  year_t year_index_base_ = 0;             // civil year of bucket 0
+
+#if defined(CCTZ_ENABLE_STATS)
+  mutable ConversionCounters counters_;  // see cctz/debug_stats.h
+#endif
+
+  // Note: The transitions found during the last BreakTime() and
+  // MakeTime() calls are remembered in per-thread hints (see
+  // ThisThreadHints() in time_zone_info.cc) so that repeat requests
+  // avoid re-searching without any cross-thread cache-line traffic.
 };
 
 }  // namespace cctz
@@ -23,14 +23,17 @@
 
 #if defined(__APPLE__)
 #include <CoreFoundation/CFTimeZone.h>
-#include <vector>
 #endif
 
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <future>
+#include <mutex>
 #include <string>
+#include <vector>
 
-#include "time_zone_fixed.h"
 #include "time_zone_impl.h"
 
 namespace cctz {
@@ -68,12 +71,22 @@ std::string time_zone::name() const {
   return effective_impl().Name();
 }
 
-time_zone::absolute_lookup time_zone::lookup(
+time_zone::absolute_lookup time_zone::lookup_impl(
     const time_point<seconds>& tp) const {
   return effective_impl().BreakTime(tp);
 }
 
-time_zone::civil_lookup time_zone::lookup(const civil_second& cs) const {
+void time_zone::lookup(const time_point<seconds>* tps, std::size_t n,
+                       absolute_lookup* als) const {
+  if (impl_ == nullptr) {
+    // UTC: pure per-element arithmetic. See time_zone::lookup().
+    for (std::size_t i = 0; i != n; ++i) als[i] = utc_lookup(tps[i]);
+    return;
+  }
+  effective_impl().BreakTimeBatch(tps, n, als);
+}
+
+time_zone::civil_lookup time_zone::lookup_impl(const civil_second& cs) const {
   return effective_impl().MakeTime(cs);
 }
 
@@ -87,6 +100,13 @@ bool time_zone::prev_transition(const time_point<seconds>& tp,
   return effective_impl().PrevTransition(tp, trans);
 }
 
+std::vector<time_zone::civil_transition> time_zone::transitions(
+    const time_point<seconds>& from, const time_point<seconds>& to) const {
+  std::vector<civil_transition> trans;
+  effective_impl().TransitionRange(from, to, &trans);
+  return trans;
+}
+
 std::string time_zone::version() const {
   return effective_impl().Version();
 }
@@ -97,9 +117,11 @@ std::string time_zone::description() const {
 
 const time_zone::Impl& time_zone::effective_impl() const {
   if (impl_ == nullptr) {
-    // Dereferencing an implicit-UTC time_zone is expected to be
-    // rare, so we don't mind paying a small synchronization cost.
-    return *time_zone::Impl::UTC().impl_;
+    // A null impl_ is the canonical UTC representation, so that the
+    // arithmetic-only fast paths in time_zone::lookup() recognize UTC
+    // with a single pointer test. Everything else dereferences the
+    // (lazily loaded) UTC Impl here.
+    return *time_zone::Impl::UTCImpl();
   }
   return *impl_;
 }
@@ -110,14 +132,51 @@ bool load_time_zone(char_range name, time_zone* tz) {
 }
 }
 
+std::shared_future<time_zone> load_time_zone_async(const std::string& name) {
+  return time_zone::Impl::LoadTimeZoneAsync(name);
+}
+
+bool load_time_zones(const std::vector<std::string>& names) {
+  return time_zone::Impl::LoadTimeZones(names);
+}
+
+bool reload_time_zones() {
+  return time_zone::Impl::ReloadTimeZones();
+}
+
 time_zone utc_time_zone() {
   return time_zone::Impl::UTC();  // avoid name lookup
 }
 
 time_zone fixed_time_zone(const seconds& offset) {
-  time_zone tz;
-  load_time_zone(FixedOffsetToName(offset), &tz);
-  return tz;
+  return time_zone::Impl::FixedTimeZone(offset);  // avoid name lookup
+}
+
+namespace {
+
+// The result of the most recent local_time_zone() environment sniff.
+// A snapshot is immutable once published, so the steady-state path is
+// lock free; superseded snapshots are retired, not deleted, as readers
+// may still be using them (the same discipline as the time-zone map in
+// time_zone_impl.cc).
+struct LocalZone {
+  std::string name;  // the sniffed zone name
+  time_zone tz;      // the loaded zone
+};
+std::atomic<const LocalZone*> local_zone{nullptr};
+
+void PublishLocalZone(const LocalZone* zone) {
+  static std::mutex* mutex = new std::mutex;  // never destroyed
+  static auto* retired = new std::deque<const LocalZone*>;
+  std::lock_guard<std::mutex> lock(*mutex);
+  const LocalZone* old = local_zone.exchange(zone, std::memory_order_acq_rel);
+  if (old != nullptr) retired->push_back(old);
+}
+
+}  // namespace
+
+void invalidate_local_time_zone() {
+  PublishLocalZone(nullptr);
 }
 
 time_zone local_time_zone() {
@@ -168,6 +227,21 @@ time_zone local_time_zone() {
     if (localtime_env) zone = localtime_env;
   }
 
+  // If the environment still names the zone we last loaded, return the
+  // cached result, skipping the zone-map lookup. Changes to ${TZ} and
+  // ${LOCALTIME} are thus noticed here, but a zone whose *name* is
+  // unchanged while its data has been replaced (e.g., /etc/localtime
+  // was repointed) needs invalidate_local_time_zone().
+  if (const LocalZone* cached = local_zone.load(std::memory_order_acquire)) {
+    if (strcmp(zone, cached->name.c_str()) == 0) {
+#if defined(_MSC_VER)
+      free(localtime_env);
+      free(tz_env);
+#endif
+      return cached->tz;
+    }
+  }
+
   const std::string name = zone;
 #if defined(_MSC_VER)
   free(localtime_env);
@@ -179,6 +253,7 @@ time_zone local_time_zone() {
   // TODO: Follow the RFC3339 "Unknown Local Offset Convention" and
   // arrange for %z to generate "-0000" when we don't know the local
   // offset because the load_time_zone() failed and we're using UTC.
+  PublishLocalZone(new LocalZone{name, tz});
   return tz;
 }
 
@@ -16,6 +16,7 @@
 
 #include <chrono>
 #include <cstddef>
+#include <cstdio>
 #include <cstdlib>
 #include <future>
 #include <limits>
@@ -24,6 +25,7 @@
 #include <vector>
 
 #include "cctz/civil_time.h"
+#include "cctz/debug_stats.h"
 #include "gtest/gtest.h"
 
 namespace chrono = std::chrono;
@@ -714,6 +716,76 @@ TEST(TimeZones, LoadZonesConcurrently) {
   EXPECT_LE(failures.size(), max_failures) << testing::PrintToString(failures);
 }
 
+TEST(TimeZones, LoadZonesBulk) {
+  EXPECT_TRUE(
+      load_time_zones({"America/New_York", "Australia/Sydney", "UTC"}));
+
+  std::vector<std::string> names;
+  for (const char* const* np = kTimeZoneNames; *np != nullptr; ++np) {
+    names.push_back(*np);
+  }
+  names.push_back("Invalid/TimeZone");
+  EXPECT_FALSE(load_time_zones(names));  // the invalid zone fails
+
+  // The preloaded zones are now served from the cache, and the invalid
+  // zone still fails (and still behaves as UTC) on individual loads.
+  time_zone tz;
+  EXPECT_TRUE(load_time_zone("America/New_York", &tz));
+  EXPECT_EQ("America/New_York", tz.name());
+  EXPECT_FALSE(load_time_zone("Invalid/TimeZone", &tz));
+  EXPECT_EQ(chrono::system_clock::from_time_t(0),
+            convert(civil_second(1970, 1, 1, 0, 0, 0), tz));  // UTC
+
+  // Preloading again is idempotent, and still reports the failure.
+  EXPECT_FALSE(load_time_zones(names));
+}
+
+TEST(TimeZones, LoadZonesAsync) {
+  // "UTC" (and anything already cached) resolves to a ready future.
+  std::shared_future<time_zone> utc = load_time_zone_async("UTC");
+  EXPECT_EQ(utc_time_zone(), utc.get());
+
+  // The future yields what load_time_zone() would produce, and loads
+  // for different names may be in flight at once.
+  std::shared_future<time_zone> la = load_time_zone_async("America/Los_Angeles");
+  std::shared_future<time_zone> syd = load_time_zone_async("Australia/Sydney");
+  EXPECT_EQ("America/Los_Angeles", la.get().name());
+  EXPECT_EQ("Australia/Sydney", syd.get().name());
+  EXPECT_EQ(LoadZone("America/Los_Angeles"), la.get());
+
+  // An invalid zone falls back to UTC, just as with load_time_zone().
+  std::shared_future<time_zone> bad = load_time_zone_async("Invalid/TimeZone");
+  EXPECT_EQ(utc_time_zone(), bad.get());
+
+  // Repeated requests for one name are all satisfied.
+  std::vector<std::shared_future<time_zone>> futures;
+  for (int i = 0; i != 4; ++i) {
+    futures.push_back(load_time_zone_async("America/New_York"));
+  }
+  for (const auto& fut : futures) {
+    EXPECT_EQ("America/New_York", fut.get().name());
+  }
+}
+
+TEST(TimeZones, ReloadZones) {
+  const time_zone nyc = LoadZone("America/New_York");
+  const auto tp = convert(civil_second(2011, 5, 1, 9, 2, 3), nyc);
+
+  // An invalid zone is cached as a failure, so a reload reports that it
+  // still cannot be loaded.
+  time_zone tz;
+  EXPECT_FALSE(load_time_zone("Invalid/TimeZone", &tz));
+  EXPECT_FALSE(reload_time_zones());
+
+  // The outstanding handle works against the refreshed data.
+  EXPECT_EQ(tp, convert(civil_second(2011, 5, 1, 9, 2, 3), nyc));
+  EXPECT_EQ(civil_second(2011, 5, 1, 9, 2, 3), convert(tp, nyc));
+
+  // And so does a handle loaded after the reload.
+  const time_zone nyc2 = LoadZone("America/New_York");
+  EXPECT_EQ(tp, convert(civil_second(2011, 5, 1, 9, 2, 3), nyc2));
+}
+
 TEST(TimeZone, NamedTimeZones) {
   const time_zone utc = utc_time_zone();
   EXPECT_EQ("UTC", utc.name());
@@ -731,6 +803,59 @@ TEST(TimeZone, NamedTimeZones) {
   EXPECT_EQ("Fixed/UTC-12:34:56", fixed_neg.name());
 }
 
+TEST(TimeZone, UTCHandlesAgree) {
+  // However a UTC handle was obtained, its lookups (including those
+  // served by the arithmetic-only fast path) must agree with the
+  // zoneinfo-backed "UTC" zone, and all such handles compare equal.
+  const time_zone utc = utc_time_zone();
+  const time_zone loaded = LoadZone("UTC");
+  const time_zone fixed0 = fixed_time_zone(cctz::seconds::zero());
+  const time_zone implicit;
+  EXPECT_EQ(utc, loaded);
+  EXPECT_EQ(utc, fixed0);
+  EXPECT_EQ(utc, implicit);
+  for (const auto& tp : {chrono::system_clock::from_time_t(0),
+                         chrono::system_clock::from_time_t(1234567890),
+                         chrono::system_clock::from_time_t(-86400)}) {
+    const time_zone::absolute_lookup a = utc.lookup(tp);
+    const time_zone::absolute_lookup b = loaded.lookup(tp);
+    EXPECT_EQ(b.cs, a.cs);
+    EXPECT_EQ(b.offset, a.offset);
+    EXPECT_EQ(b.is_dst, a.is_dst);
+    EXPECT_STREQ(b.abbr, a.abbr);
+  }
+  for (const auto& cs : {civil_second(1970, 1, 1, 0, 0, 0),
+                         civil_second(2009, 2, 13, 23, 31, 30),
+                         civil_second(-1, 12, 31, 23, 59, 59)}) {
+    const time_zone::civil_lookup a = utc.lookup(cs);
+    const time_zone::civil_lookup b = loaded.lookup(cs);
+    EXPECT_EQ(time_zone::civil_lookup::UNIQUE, a.kind);
+    EXPECT_EQ(b.kind, a.kind);
+    EXPECT_EQ(b.pre, a.pre);
+    EXPECT_EQ(b.trans, a.trans);
+    EXPECT_EQ(b.post, a.post);
+  }
+}
+
+TEST(TimeZone, LocalTimeZoneCached) {
+#if defined(__linux__) && !defined(__ANDROID__)
+  const char* const ep = getenv("TZ");
+  const std::string tz_name = (ep != nullptr) ? ep : "";
+  ASSERT_EQ(0, setenv("TZ", "America/New_York", 1));  // cache this zone
+  EXPECT_EQ(local_time_zone(), local_time_zone());
+  ASSERT_EQ(0, setenv("TZ", "Australia/Sydney", 1));  // notice the change
+  const time_zone syd = local_time_zone();
+  EXPECT_EQ("Australia/Sydney", syd.name());
+  invalidate_local_time_zone();  // force a fresh sniff
+  EXPECT_EQ(syd, local_time_zone());
+  if (ep != nullptr) {
+    ASSERT_EQ(0, setenv("TZ", tz_name.c_str(), 1));
+  } else {
+    ASSERT_EQ(0, unsetenv("TZ"));
+  }
+#endif
+}
+
 TEST(TimeZone, Failures) {
   time_zone tz;
   EXPECT_FALSE(load_time_zone(":America/Los_Angeles", &tz));
@@ -753,6 +878,108 @@ TEST(TimeZone, Failures) {
             convert(civil_second(1970, 1, 1, 0, 0, 0), tz));  // UTC
 }
 
+TEST(TimeZone, PosixTZSpecs) {
+  // A name matching no zoneinfo data but parseable as a POSIX TZ rule
+  // string (the libc interpretation of such a ${TZ} value) loads as a
+  // native zone rather than falling back to UTC.
+  const time_zone tz = LoadZone("PST8PDT,M3.2.0,M11.1.0");
+  EXPECT_EQ("PST8PDT,M3.2.0,M11.1.0", tz.name());
+
+  // The spec carries the post-2006 US rules, so it should agree with
+  // zoneinfo's America/Los_Angeles throughout that era.
+  const time_zone lax = LoadZone("America/Los_Angeles");
+  for (year_t y = 2007; y != 2027; ++y) {
+    for (const int m : {1, 4, 7, 10}) {
+      const civil_second cs(y, m, 15, 12, 0, 0);
+      EXPECT_EQ(convert(cs, lax), convert(cs, tz)) << cs;
+    }
+  }
+
+  // Spring forward: 2:30 is skipped.
+  const time_zone::civil_lookup spring =
+      tz.lookup(civil_second(2011, 3, 13, 2, 30, 0));
+  EXPECT_EQ(time_zone::civil_lookup::SKIPPED, spring.kind);
+  ExpectTime(spring.trans, tz, 2011, 3, 13, 3, 0, 0, -7 * 60 * 60, true,
+             "PDT");
+
+  // Fall back: 1:30 is repeated.
+  const time_zone::civil_lookup fall =
+      tz.lookup(civil_second(2011, 11, 6, 1, 30, 0));
+  EXPECT_EQ(time_zone::civil_lookup::REPEATED, fall.kind);
+  ExpectTime(fall.trans, tz, 2011, 11, 6, 1, 0, 0, -8 * 60 * 60, false,
+             "PST");
+
+  // A rules-free spec behaves as a fixed zone.
+  const time_zone est = LoadZone("EST5");
+  EXPECT_EQ("EST5", est.name());
+  const auto tp = convert(civil_second(2020, 6, 1, 0, 0, 0), est);
+  ExpectTime(tp, est, 2020, 6, 1, 0, 0, 0, -5 * 60 * 60, false, "EST");
+  time_zone::civil_transition trans;
+  EXPECT_FALSE(est.next_transition(tp, &trans));
+
+  // Names that parse as neither zoneinfo nor a POSIX spec still fail.
+  time_zone bad = LoadZone("America/Los_Angeles");
+  EXPECT_FALSE(load_time_zone("NotASpec", &bad));
+  EXPECT_EQ(chrono::system_clock::from_time_t(0),
+            convert(civil_second(1970, 1, 1, 0, 0, 0), bad));  // UTC
+}
+
+TEST(TimeZone, TzdataArchive) {
+#if defined(__linux__) && !defined(__ANDROID__)
+  // Build a small indexed tzdata archive (see time_zone_info.cc for
+  // the format) and serve a zone from it via ${CCTZ_TZDATA}. The entry
+  // is given a name that no zoneinfo directory provides so the load
+  // can only succeed through the archive.
+  const char* const tzdir = getenv("TZDIR");
+  if (tzdir == nullptr) return;  // requires the testdata zoneinfo
+  std::string tzif;
+  {
+    FILE* fp = fopen((std::string(tzdir) + "/America/New_York").c_str(), "rb");
+    ASSERT_NE(nullptr, fp);
+    char buf[4096];
+    while (std::size_t nread = fread(buf, 1, sizeof(buf), fp)) {
+      tzif.append(buf, nread);
+    }
+    fclose(fp);
+  }
+
+  const auto encode32 = [](std::string* out, std::size_t v) {
+    for (int shift = 24; shift >= 0; shift -= 8) {
+      out->push_back(static_cast<char>((v >> shift) & 0xff));
+    }
+  };
+  const std::string name = "Test/TzdataArchive";
+  std::string archive("tzarchv1");
+  encode32(&archive, 1);  // zone count
+  archive.append("9999z");
+  archive.append(12 - 5, '\0');  // NUL-padded version
+  archive.append(name);
+  archive.append(40 - name.size(), '\0');  // NUL-padded index entry
+  encode32(&archive, 0);            // data offset
+  encode32(&archive, tzif.size());  // data length
+  archive += tzif;
+
+  const std::string path = ::testing::TempDir() + "cctz_test_tzdata.cctz";
+  {
+    FILE* fp = fopen(path.c_str(), "wb");
+    ASSERT_NE(nullptr, fp);
+    ASSERT_EQ(archive.size(), fwrite(archive.data(), 1, archive.size(), fp));
+    fclose(fp);
+  }
+
+  ASSERT_EQ(0, setenv("CCTZ_TZDATA", path.c_str(), 1));
+  time_zone tz;
+  EXPECT_TRUE(load_time_zone(name, &tz));
+  ASSERT_EQ(0, unsetenv("CCTZ_TZDATA"));
+  remove(path.c_str());
+
+  EXPECT_EQ("9999z", tz.version());
+  const time_zone nyc = LoadZone("America/New_York");
+  const civil_second cs(2016, 7, 4, 12, 0, 0);
+  EXPECT_EQ(convert(cs, nyc), convert(cs, tz));
+#endif
+}
+
 TEST(TimeZone, Equality) {
   const time_zone a;
   const time_zone b;
@@ -883,6 +1110,58 @@ TEST(BreakTime, LocalTimeInSydney) {
   EXPECT_EQ(weekday::thursday, get_weekday(convert(tp, tz)));
 }
 
+TEST(BreakTime, BulkLookup) {
+  const time_zone tz = LoadZone("America/New_York");
+
+  // A mix of clustered, DST-boundary-straddling, and out-of-order time
+  // points, plus values outside the zone's transition range.
+  std::vector<time_point<cctz::seconds>> tps;
+  const auto spring = convert(civil_second(2011, 3, 13, 1, 59, 59), tz);
+  for (int i = -3; i <= 3; ++i) tps.push_back(spring + cctz::seconds(i));
+  const auto fall = convert(civil_second(2011, 11, 6, 1, 15, 0), tz);
+  for (int i = 3; i >= -3; --i) tps.push_back(fall + cctz::seconds(i * 3600));
+  tps.push_back(time_point<cctz::seconds>::min());
+  tps.push_back(time_point<cctz::seconds>::max());
+  tps.push_back(convert(civil_second(1883, 1, 1, 0, 0, 0), tz));
+
+  std::vector<time_zone::absolute_lookup> als(tps.size());
+  tz.lookup(tps.data(), tps.size(), als.data());
+  for (std::size_t i = 0; i != tps.size(); ++i) {
+    const time_zone::absolute_lookup al = tz.lookup(tps[i]);
+    EXPECT_EQ(al.cs, als[i].cs) << "index " << i;
+    EXPECT_EQ(al.offset, als[i].offset) << "index " << i;
+    EXPECT_EQ(al.is_dst, als[i].is_dst) << "index " << i;
+    EXPECT_STREQ(al.abbr, als[i].abbr) << "index " << i;
+  }
+
+  // The convert() variant writes the same results.
+  std::vector<time_zone::absolute_lookup> als2(tps.size());
+  convert(tps.data(), tps.size(), tz, als2.data());
+  for (std::size_t i = 0; i != tps.size(); ++i) {
+    EXPECT_EQ(als[i].cs, als2[i].cs) << "index " << i;
+  }
+}
+
+TEST(BreakTime, FanOutLookup) {
+  const std::vector<time_zone> tzs = {
+      LoadZone("America/New_York"), LoadZone("America/Los_Angeles"),
+      LoadZone("Australia/Sydney"), utc_time_zone(),
+      fixed_time_zone(chrono::hours(5) + chrono::minutes(30)),
+  };
+
+  const auto tp = convert(civil_second(2011, 3, 13, 2, 15, 0),
+                          utc_time_zone());
+  std::vector<time_zone::absolute_lookup> als(tzs.size());
+  convert(tp, tzs.data(), tzs.size(), als.data());
+  for (std::size_t i = 0; i != tzs.size(); ++i) {
+    const time_zone::absolute_lookup al = tzs[i].lookup(tp);
+    EXPECT_EQ(al.cs, als[i].cs) << tzs[i].name();
+    EXPECT_EQ(al.offset, als[i].offset) << tzs[i].name();
+    EXPECT_EQ(al.is_dst, als[i].is_dst) << tzs[i].name();
+    EXPECT_STREQ(al.abbr, als[i].abbr) << tzs[i].name();
+  }
+}
+
 TEST(MakeTime, TimePointResolution) {
   const time_zone utc = utc_time_zone();
   const time_point<chrono::nanoseconds> tp_ns =
@@ -1157,6 +1436,110 @@ TEST(PrevTransition, AmericaNewYork) {
   // We have a transition but we don't know which one.
 }
 
+TEST(TransitionRange, AmericaNewYork) {
+  const auto tz = LoadZone("America/New_York");
+  const auto utc = utc_time_zone();
+
+  // Windows over the stored data, straddling the end of the stored data,
+  // and entirely within the on-demand future rules.
+  const struct {
+    civil_second from;
+    civil_second to;
+  } kWindows[] = {
+      {civil_second(2010, 1, 1, 0, 0, 0), civil_second(2014, 1, 1, 0, 0, 0)},
+      {civil_second(2035, 1, 1, 0, 0, 0), civil_second(2043, 6, 1, 0, 0, 0)},
+      {civil_second(2115, 1, 1, 0, 0, 0), civil_second(2120, 1, 1, 0, 0, 0)},
+  };
+  for (const auto& w : kWindows) {
+    const auto from = convert(w.from, utc);
+    const auto to = convert(w.to, utc);
+    const auto trans = tz.transitions(from, to);
+
+    // The range must match a chain of next_transition() calls.
+    std::vector<time_zone::civil_transition> expected;
+    time_zone::civil_transition t;
+    for (auto tp = from; tz.next_transition(tp, &t);) {
+      tp = tz.lookup(t.to).trans;
+      if (tp > to) break;
+      expected.push_back(t);
+    }
+    EXPECT_FALSE(expected.empty());
+    ASSERT_EQ(expected.size(), trans.size());
+    for (std::size_t i = 0; i != trans.size(); ++i) {
+      EXPECT_EQ(expected[i].from, trans[i].from) << i;
+      EXPECT_EQ(expected[i].to, trans[i].to) << i;
+    }
+  }
+
+  // Two transitions per year.
+  const auto y2011 = convert(civil_second(2011, 1, 1, 0, 0, 0), utc);
+  const auto y2015 = convert(civil_second(2015, 1, 1, 0, 0, 0), utc);
+  EXPECT_EQ(8, tz.transitions(y2011, y2015).size());
+
+  // Empty and inverted windows, and zones without transitions.
+  EXPECT_TRUE(tz.transitions(y2011, y2011).empty());
+  EXPECT_TRUE(tz.transitions(y2015, y2011).empty());
+  EXPECT_TRUE(utc.transitions(y2011, y2015).empty());
+  EXPECT_TRUE(fixed_time_zone(seconds(3600)).transitions(y2011, y2015).empty());
+}
+
+TEST(NextTransition, EarliestAcrossZones) {
+  const time_zone tzs[] = {LoadZone("America/New_York"),
+                           LoadZone("Europe/London"),
+                           LoadZone("Australia/Sydney"), utc_time_zone()};
+  const std::size_t n = sizeof(tzs) / sizeof(tzs[0]);
+
+  // From New Year 2011, New York springs forward (Mar 13) before London
+  // (Mar 27), and Sydney's DST doesn't end until April.
+  const auto tp = convert(civil_second(2011, 1, 1, 0, 0, 0), utc_time_zone());
+  std::size_t which;
+  time_point<cctz::seconds> when;
+  time_zone::civil_transition trans;
+  ASSERT_TRUE(next_transition(tp, tzs, n, &which, &when, &trans));
+  EXPECT_EQ(0, which);
+  EXPECT_EQ(convert(civil_second(2011, 3, 13, 7, 0, 0), utc_time_zone()),
+            when);
+  EXPECT_EQ(civil_second(2011, 3, 13, 2, 0, 0), trans.from);
+  EXPECT_EQ(civil_second(2011, 3, 13, 3, 0, 0), trans.to);
+  for (std::size_t i = 0; i != n; ++i) {
+    time_zone::civil_transition t;
+    if (tzs[i].next_transition(tp, &t)) {
+      EXPECT_LE(when, tzs[i].lookup(t.to).trans) << i;
+    }
+  }
+
+  // No zone in the list has any transitions.
+  const time_zone quiet[] = {utc_time_zone(), fixed_time_zone(seconds(-3600))};
+  EXPECT_FALSE(next_transition(tp, quiet, 2, &which, &when, &trans));
+}
+
+TEST(TimeZoneEdgeCase, AsiaTokyo) {
+  const time_zone tz = LoadZone("Asia/Tokyo");
+  const time_zone utc = utc_time_zone();
+
+  // Japan last observed daylight-saving time in the summer of 1951, so
+  // the zone has since been in a fixed +9 steady state. Probe the final
+  // transition (the fall back from JDT +10 to JST +9)...
+  auto tp = convert(civil_second(1951, 9, 8, 14, 59, 59), utc);
+  ExpectTime(tp, tz, 1951, 9, 9, 0, 59, 59, 10 * 3600, true, "JDT");
+  tp += cctz::seconds(1);
+  ExpectTime(tp, tz, 1951, 9, 9, 0, 0, 0, 9 * 3600, false, "JST");
+
+  // ...and the repeated civil hour surrounding it.
+  const auto cl = tz.lookup(civil_second(1951, 9, 9, 0, 30, 0));
+  EXPECT_EQ(time_zone::civil_lookup::REPEATED, cl.kind);
+  EXPECT_EQ(tp, cl.trans);
+
+  // Conversions in both directions stay +9 from then on.
+  for (cctz::year_t y = 1952; y <= 2102; y += 10) {
+    const civil_second cs(y, 6, 15, 12, 30, 45);
+    const auto cl2 = tz.lookup(cs);
+    EXPECT_EQ(time_zone::civil_lookup::UNIQUE, cl2.kind);
+    EXPECT_EQ(convert(cs - 9 * 3600, utc), cl2.pre);
+    ExpectTime(cl2.pre, tz, y, 6, 15, 12, 30, 45, 9 * 3600, false, "JST");
+  }
+}
+
 TEST(TimeZoneEdgeCase, AmericaNewYork) {
   const time_zone tz = LoadZone("America/New_York");
 
@@ -1428,4 +1811,31 @@ TEST(TimeZoneEdgeCase, UTC5DigitYear) {
   ExpectTime(tp, tz, 10000, 1, 1, 0, 0, 0, 0 * 3600, false, "UTC");
 }
 
+TEST(DebugStats, CollectionSurface) {
+  const time_zone tz = LoadZone("America/New_York");
+  const auto tp = convert(civil_second(2011, 6, 1, 12, 0, 0), tz);
+  static_cast<void>(tz.lookup(tp));
+
+  std::vector<debug::zone_stats> zone_stats;
+  debug::format_stats format_stats;
+  const bool enabled = debug::zone_conversion_stats(&zone_stats);
+  EXPECT_EQ(enabled, debug::formatting_stats(&format_stats));
+  if (!enabled) {  // the default build
+    EXPECT_TRUE(zone_stats.empty());  // left unmodified
+    return;
+  }
+
+  // Compiled with CCTZ_ENABLE_STATS, so the conversions above counted.
+  bool found = false;
+  for (const debug::zone_stats& zs : zone_stats) {
+    if (zs.zone_name == "America/New_York") {
+      found = true;
+      EXPECT_NE(zs.break_time_calls, 0);
+      EXPECT_NE(zs.make_time_calls, 0);
+    }
+  }
+  EXPECT_TRUE(found);
+  debug::reset_stats();
+}
+
 }  // namespace cctz
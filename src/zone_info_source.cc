@@ -18,6 +18,7 @@ namespace cctz {
 
 // Defined out-of-line to avoid emitting a weak vtable in all TUs.
 ZoneInfoSource::~ZoneInfoSource() {}
+const char* ZoneInfoSource::BorrowBytes(std::size_t) { return nullptr; }
 std::string ZoneInfoSource::Version() const { return std::string(); }
 
 }  // namespace cctz